@@ -0,0 +1,285 @@
+/**
+ * Standalone benchmark of the Mypack gamma kernels (cgamma.h).
+ *
+ * Links only the R-free sources, so it runs without an R installation
+ * and measures the kernels without the .Call and coercion overhead
+ * (bench/cgammabench.R measures the R interface). For every
+ * combination of function, input type, half-plane, precision, kernel,
+ * size and thread count it reports ns/element, GB/s (input read plus
+ * output written) and the speedup over the first thread count (one by
+ * default), as a table on stderr and, with --json, as a JSON document
+ * that can be diffed between builds.
+ *
+ * Usage: cgammabench [--sizes 1000,100000,...] [--threads 1,2,4,...]
+ *                    [--precision fast,standard,high] [--kernel all|name]
+ *                    [--functions cgamma,clgamma] [--min-time seconds]
+ *                    [--json file|-]
+ */
+
+#include "cgamma.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+#if defined(__clang__)
+const char* compiler_info = "Clang " __clang_version__;
+#elif defined(__GNUC__)
+const char* compiler_info = "GNU g++ " __VERSION__;
+#elif defined(_MSC_VER)
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+const char* compiler_info = "MSVC " TOSTRING(_MSC_FULL_VER);
+#else
+const char* compiler_info = "Unknown Compiler";
+#endif
+
+struct Options {
+    std::vector<std::size_t> sizes;
+    std::vector<int> threads;
+    std::vector<std::string> precisions;
+    std::vector<std::string> kernels;
+    std::vector<std::string> functions;
+    double min_time;
+    std::string json;
+};
+
+struct Result {
+    std::string function, input, half_plane, precision, kernel;
+    std::size_t size;
+    int threads;
+    double ns_per_element, gb_per_s, speedup;
+};
+
+std::vector<std::string> split(const std::string& s) {
+    std::vector<std::string> v;
+    std::stringstream ss(s);
+    std::string item;
+    while(std::getline(ss, item, ','))
+	if(!item.empty())
+	    v.push_back(item);
+    return v;
+}
+
+void usage() {
+    std::fprintf(stderr,
+		 "Usage: cgammabench [--sizes n,...] [--threads n,...]\n"
+		 "                   [--precision fast,standard,high]\n"
+		 "                   [--kernel all|avx512|avx2|scalar]\n"
+		 "                   [--functions cgamma,clgamma]\n"
+		 "                   [--min-time seconds] [--json file|-]\n");
+    std::exit(2);
+}
+
+Options parse_args(int argc, char** argv) {
+    Options opt;
+    opt.sizes = {100, 1000, 10000, 100000, 1000000};
+    int hw = (int)std::max(1u, std::thread::hardware_concurrency());
+    for(int t = 1; t < hw; t *= 2)
+	opt.threads.push_back(t);
+    opt.threads.push_back(hw);
+    opt.precisions = {"standard"};
+    opt.kernels = {cgamma_kernel_name()};
+    opt.functions = {"cgamma", "clgamma"};
+    opt.min_time = 0.1;
+
+    for(int i = 1; i < argc; ++i) {
+	std::string arg = argv[i];
+	if(i + 1 >= argc)
+	    usage();
+	std::string val = argv[++i];
+	if(arg == "--sizes") {
+	    opt.sizes.clear();
+	    for(const std::string& s : split(val))
+		opt.sizes.push_back((std::size_t)std::strtod(s.c_str(), 0));
+	}
+	else if(arg == "--threads") {
+	    opt.threads.clear();
+	    for(const std::string& s : split(val))
+		opt.threads.push_back(std::atoi(s.c_str()));
+	}
+	else if(arg == "--precision")
+	    opt.precisions = split(val);
+	else if(arg == "--kernel")
+	    opt.kernels = val == "all" ?
+		std::vector<std::string>{"avx512", "avx2", "scalar"} : split(val);
+	else if(arg == "--functions")
+	    opt.functions = split(val);
+	else if(arg == "--min-time")
+	    opt.min_time = std::atof(val.c_str());
+	else if(arg == "--json")
+	    opt.json = val;
+	else
+	    usage();
+    }
+    return opt;
+}
+
+CgammaPrecision precision_of(const std::string& name) {
+    CgammaPrecision prec;
+    if(!cgamma_parse_precision(name.c_str(), &prec)) {
+	std::fprintf(stderr, "cgammabench: unknown precision '%s'\n",
+		     name.c_str());
+	std::exit(2);
+    }
+    return prec;
+}
+
+// Arguments drawn from a fixed seed, so every build times the same
+// values: Re(z) in [0.5, 20) for the right half-plane and [-20, 0.5)
+// for the left, Im(z) in [-10, 10) for complex input.
+std::vector<std::complex<double> > make_input(std::size_t n, bool left,
+					       bool real) {
+    std::mt19937_64 rng(12345);
+    std::uniform_real_distribution<double> re(left ? -20.0 : 0.5,
+					      left ? 0.5 : 20.0);
+    std::uniform_real_distribution<double> im(-10.0, 10.0);
+    std::vector<std::complex<double> > z(n);
+    for(std::size_t i = 0; i < n; ++i) {
+	double a = re(rng);
+	z[i] = std::complex<double>(a, real ? 0.0 : im(rng));
+    }
+    return z;
+}
+
+// Runs fn until at least min_time seconds have elapsed, in rounds
+// sized from a first timed call, and returns the median time per call
+// in seconds over the rounds.
+template<class Fn>
+double time_call(Fn fn, double min_time) {
+    typedef std::chrono::steady_clock clock;
+    fn();                                       // warm up, page in
+    clock::time_point t0 = clock::now();
+    fn();
+    double once = std::chrono::duration<double>(clock::now() - t0).count();
+    const int rounds = 5;
+    std::size_t reps = (std::size_t)std::max(1.0, min_time/rounds/std::max(once, 1e-9));
+    std::vector<double> per_call;
+    for(int r = 0; r < rounds; ++r) {
+	t0 = clock::now();
+	for(std::size_t k = 0; k < reps; ++k)
+	    fn();
+	per_call.push_back(std::chrono::duration<double>(clock::now() - t0).count()/reps);
+    }
+    std::sort(per_call.begin(), per_call.end());
+    return per_call[rounds/2];
+}
+
+void write_json(std::FILE* f, const Options& opt,
+		const std::vector<Result>& results) {
+    std::fprintf(f, "{\n");
+    std::fprintf(f, "  \"benchmark\": \"cgammabench\",\n");
+    std::fprintf(f, "  \"compiler\": \"%s\",\n", compiler_info);
+    std::fprintf(f, "  \"hardware_threads\": %u,\n",
+		 std::thread::hardware_concurrency());
+    std::fprintf(f, "  \"min_time\": %g,\n", opt.min_time);
+    std::fprintf(f, "  \"results\": [\n");
+    for(std::size_t i = 0; i < results.size(); ++i) {
+	const Result& r = results[i];
+	std::fprintf(f, "    {\"function\": \"%s\", \"input\": \"%s\", "
+		     "\"half_plane\": \"%s\", \"precision\": \"%s\", "
+		     "\"kernel\": \"%s\", \"size\": %zu, \"threads\": %d, "
+		     "\"ns_per_element\": %.4g, \"gb_per_s\": %.4g, "
+		     "\"speedup\": %.3g}%s\n",
+		     r.function.c_str(), r.input.c_str(), r.half_plane.c_str(),
+		     r.precision.c_str(), r.kernel.c_str(), r.size, r.threads,
+		     r.ns_per_element, r.gb_per_s, r.speedup,
+		     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+
+    Options opt = parse_args(argc, argv);
+    std::vector<Result> results;
+
+    std::fprintf(stderr, "%-8s %-7s %-5s %-8s %-6s %9s %3s %10s %8s %7s\n",
+		 "function", "input", "plane", "prec", "kernel", "size",
+		 "thr", "ns/elem", "GB/s", "speedup");
+
+    for(const std::string& kname : opt.kernels) {
+	if(!cgamma_set_kernel(kname.c_str())) {
+	    std::fprintf(stderr, "cgammabench: kernel '%s' not available, "
+			 "skipped\n", kname.c_str());
+	    continue;
+	}
+	for(const std::string& fname : opt.functions) {
+	    bool log = fname == "clgamma";
+	    if(!log && fname != "cgamma") {
+		std::fprintf(stderr, "cgammabench: unknown function '%s'\n",
+			     fname.c_str());
+		return 2;
+	    }
+	    // Real input has a kernel of its own for cgamma only; log
+	    // Gamma of a negative real is complex.
+	    for(int real = log ? 0 : 1; real >= 0; --real)
+	    for(int left = 0; left <= 1; ++left)
+	    for(const std::string& pname : opt.precisions)
+	    for(std::size_t n : opt.sizes) {
+		CgammaPrecision prec = precision_of(pname);
+		std::vector<std::complex<double> > z = make_input(n, left, real);
+		std::vector<std::complex<double> > out(n);
+		std::vector<double> x(n), y(n);
+		for(std::size_t i = 0; i < n; ++i)
+		    x[i] = z[i].real();
+		// Bytes read plus bytes written per element.
+		double bytes = real ? 2*sizeof(double) : 2*sizeof(z[0]);
+		double base = 0;
+		for(int nthreads : opt.threads) {
+		    double secs;
+		    if(real)
+			secs = time_call([&] {
+			    cgamma_real_parallel(x.data(), y.data(), n, nthreads, prec);
+			}, opt.min_time);
+		    else if(log)
+			secs = time_call([&] {
+			    clgamma_parallel(z.data(), out.data(), n, nthreads, prec);
+			}, opt.min_time);
+		    else
+			secs = time_call([&] {
+			    cgamma_parallel(z.data(), out.data(), n, nthreads, prec);
+			}, opt.min_time);
+		    if(base == 0)
+			base = secs;
+		    Result r = {fname, real ? "real" : "complex",
+				left ? "left" : "right", pname, kname, n,
+				nthreads, 1e9*secs/n, bytes*n/secs/1e9,
+				base/secs};
+		    results.push_back(r);
+		    std::fprintf(stderr, "%-8s %-7s %-5s %-8s %-6s %9zu %3d "
+				 "%10.2f %8.3f %7.2f\n", r.function.c_str(),
+				 r.input.c_str(), r.half_plane.c_str(),
+				 r.precision.c_str(), r.kernel.c_str(), r.size,
+				 r.threads, r.ns_per_element, r.gb_per_s,
+				 r.speedup);
+		}
+	    }
+	}
+    }
+
+    if(opt.json == "-")
+	write_json(stdout, opt, results);
+    else if(!opt.json.empty()) {
+	std::FILE* f = std::fopen(opt.json.c_str(), "w");
+	if(f == 0) {
+	    std::fprintf(stderr, "cgammabench: cannot write %s\n",
+			 opt.json.c_str());
+	    return 1;
+	}
+	write_json(f, opt, results);
+	std::fclose(f);
+    }
+    return 0;
+}
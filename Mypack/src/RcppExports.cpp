@@ -10,14 +10,130 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// cgammacpp_lazy
+SEXP cgammacpp_lazy(SEXP inRvec, int nthreads, std::string precision);
+RcppExport SEXP _Mypack_cgammacpp_lazy(SEXP inRvecSEXP, SEXP nthreadsSEXP, SEXP precisionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type inRvec(inRvecSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(cgammacpp_lazy(inRvec, nthreads, precision));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cgammalazyinfo
+Rcpp::List cgammalazyinfo(SEXP x);
+RcppExport SEXP _Mypack_cgammalazyinfo(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(cgammalazyinfo(x));
+    return rcpp_result_gen;
+END_RCPP
+}
 // cgammacpp
-SEXP cgammacpp(SEXP inRvec);
-RcppExport SEXP _Mypack_cgammacpp(SEXP inRvecSEXP) {
+SEXP cgammacpp(SEXP inRvec, int nthreads, std::string precision, SEXP complex);
+RcppExport SEXP _Mypack_cgammacpp(SEXP inRvecSEXP, SEXP nthreadsSEXP, SEXP precisionSEXP, SEXP complexSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type inRvec(inRvecSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type precision(precisionSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type complex(complexSEXP);
+    rcpp_result_gen = Rcpp::wrap(cgammacpp(inRvec, nthreads, precision, complex));
+    return rcpp_result_gen;
+END_RCPP
+}
+// clgammacpp
+SEXP clgammacpp(SEXP inRvec, int nthreads, std::string precision);
+RcppExport SEXP _Mypack_clgammacpp(SEXP inRvecSEXP, SEXP nthreadsSEXP, SEXP precisionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type inRvec(inRvecSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(clgammacpp(inRvec, nthreads, precision));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cgammacpp_grid
+SEXP cgammacpp_grid(Rcpp::NumericVector re, Rcpp::NumericVector im, std::string output, int nthreads, std::string precision);
+RcppExport SEXP _Mypack_cgammacpp_grid(SEXP reSEXP, SEXP imSEXP, SEXP outputSEXP, SEXP nthreadsSEXP, SEXP precisionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type re(reSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type im(imSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type precision(precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(cgammacpp_grid(re, im, output, nthreads, precision));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cgammacpp_inplace
+SEXP cgammacpp_inplace(SEXP inRvec, int nthreads);
+RcppExport SEXP _Mypack_cgammacpp_inplace(SEXP inRvecSEXP, SEXP nthreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< SEXP >::type inRvec(inRvecSEXP);
-    rcpp_result_gen = Rcpp::wrap(cgammacpp(inRvec));
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cgammacpp_inplace(inRvec, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cgammacpp_into
+SEXP cgammacpp_into(SEXP inRvec, SEXP out, int nthreads);
+RcppExport SEXP _Mypack_cgammacpp_into(SEXP inRvecSEXP, SEXP outSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type inRvec(inRvecSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type out(outSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cgammacpp_into(inRvec, out, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cgammacpp_cache
+Rcpp::List cgammacpp_cache(bool enable, double max_mb, std::string spill_dir, double spill_max_mb);
+RcppExport SEXP _Mypack_cgammacpp_cache(SEXP enableSEXP, SEXP max_mbSEXP, SEXP spill_dirSEXP, SEXP spill_max_mbSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type enable(enableSEXP);
+    Rcpp::traits::input_parameter< double >::type max_mb(max_mbSEXP);
+    Rcpp::traits::input_parameter< std::string >::type spill_dir(spill_dirSEXP);
+    Rcpp::traits::input_parameter< double >::type spill_max_mb(spill_max_mbSEXP);
+    rcpp_result_gen = Rcpp::wrap(cgammacpp_cache(enable, max_mb, spill_dir, spill_max_mb));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cgammacachestats
+Rcpp::List cgammacachestats(bool reset);
+RcppExport SEXP _Mypack_cgammacachestats(SEXP resetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type reset(resetSEXP);
+    rcpp_result_gen = Rcpp::wrap(cgammacachestats(reset));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cgammakernel
+Rcpp::CharacterVector cgammakernel(std::string kernel);
+RcppExport SEXP _Mypack_cgammakernel(SEXP kernelSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type kernel(kernelSEXP);
+    rcpp_result_gen = Rcpp::wrap(cgammakernel(kernel));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -33,12 +149,23 @@ END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_Mypack_cgammacpp", (DL_FUNC) &_Mypack_cgammacpp, 1},
+    {"_Mypack_cgammacpp_lazy", (DL_FUNC) &_Mypack_cgammacpp_lazy, 3},
+    {"_Mypack_cgammalazyinfo", (DL_FUNC) &_Mypack_cgammalazyinfo, 1},
+    {"_Mypack_cgammacpp", (DL_FUNC) &_Mypack_cgammacpp, 4},
+    {"_Mypack_clgammacpp", (DL_FUNC) &_Mypack_clgammacpp, 3},
+    {"_Mypack_cgammacpp_grid", (DL_FUNC) &_Mypack_cgammacpp_grid, 5},
+    {"_Mypack_cgammacpp_inplace", (DL_FUNC) &_Mypack_cgammacpp_inplace, 2},
+    {"_Mypack_cgammacpp_into", (DL_FUNC) &_Mypack_cgammacpp_into, 3},
+    {"_Mypack_cgammacpp_cache", (DL_FUNC) &_Mypack_cgammacpp_cache, 4},
+    {"_Mypack_cgammacachestats", (DL_FUNC) &_Mypack_cgammacachestats, 1},
+    {"_Mypack_cgammakernel", (DL_FUNC) &_Mypack_cgammakernel, 1},
     {"_Mypack_cpptoolchain", (DL_FUNC) &_Mypack_cpptoolchain, 0},
     {NULL, NULL, 0}
 };
 
+void cgamma_lazy_init(DllInfo* dll);
 RcppExport void R_init_Mypack(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    cgamma_lazy_init(dll);
 }
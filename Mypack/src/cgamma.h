@@ -0,0 +1,139 @@
+/**
+ * Complex gamma kernels shared by the R interface in complexgamma.cpp.
+ * Nothing declared here touches the R API, so these functions may be
+ * called from any thread and linked into programs that do not embed R.
+ */
+
+#ifndef MYPACK_CGAMMA_H
+#define MYPACK_CGAMMA_H
+
+#include <complex>
+#include <cstddef>
+
+extern const double cgamma_pi;
+
+// Accuracy tiers, selected at compile time through the template
+// parameter of the functions below. In the right half-plane the
+// relative error of log Gamma is about 1e-11 for FAST and 4e-15 for
+// STANDARD. HIGH uses STANDARD for |z| < 10 and the Stirling series
+// beyond, which has no fixed approximation error and is the most
+// accurate choice for large |z|.
+enum CgammaPrecision {
+    CGAMMA_FAST,                // Lanczos, g=5, 7 terms
+    CGAMMA_STANDARD,            // Lanczos, g=7, 9 terms
+    CGAMMA_HIGH                 // Stirling series for |z| >= 10
+};
+
+// Parses "fast", "standard" or "high" into *precision; returns false
+// (leaving *precision unchanged) for any other name.
+bool cgamma_parse_precision(const char* name, CgammaPrecision* precision);
+
+// Lanczos coefficient tables. The tables are shared by the scalar and
+// batched kernels so that both evaluate the same series.
+template<CgammaPrecision P> struct Lanczos;
+
+template<> struct Lanczos<CGAMMA_FAST> {
+    static const int g = 5;
+    static const int n = 7;
+    static const double p[n];
+};
+
+template<> struct Lanczos<CGAMMA_STANDARD> {
+    static const int g = 7;
+    static const int n = 9;
+    static const double p[n];
+};
+
+// Scalar reference implementations of a single complex argument:
+// Gamma(z), and log Gamma(z) computed without forming Gamma(z), so it
+// does not overflow for large |z|. In the right half-plane clgamma()
+// is the analytic continuation of the real log-gamma function; in the
+// left half-plane (reflection) its imaginary part is determined only
+// modulo 2 pi.
+template<CgammaPrecision P = CGAMMA_STANDARD>
+std::complex<double> cgamma(std::complex<double> z);
+template<CgammaPrecision P = CGAMMA_STANDARD>
+std::complex<double> clgamma(std::complex<double> z);
+template<> std::complex<double> cgamma<CGAMMA_HIGH>(std::complex<double> z);
+template<> std::complex<double> clgamma<CGAMMA_HIGH>(std::complex<double> z);
+
+// Gamma(x) for real x, the same Lanczos (or Stirling) evaluation as
+// cgamma() carried out in real arithmetic.
+template<CgammaPrecision P = CGAMMA_STANDARD>
+double cgamma_real(double x);
+template<> double cgamma_real<CGAMMA_HIGH>(double x);
+
+// log(sin(pi z)), evaluated without overflow for large |Im(z)|.
+std::complex<double> clogsinpi(std::complex<double> z);
+
+// Batched evaluation of out[i] = cgamma<P>(in[i]) (clgamma<P> for
+// clgamma_batch) for i < len. Each element is read before it is
+// written, so out may alias in. For the Lanczos tiers the result of
+// cgamma_batch agrees with cgamma() to within CGAMMA_BATCH_ULP units of
+// DBL_EPSILON relative to |cgamma(z)|, scaled by the magnitude of the
+// exponent w*log(t)-t (see cgammabatch.cpp); clgamma_batch agrees with
+// clgamma() to within the same bound in absolute terms, and
+// cgamma_real_batch agrees with cgamma_real() as cgamma_batch does with
+// cgamma(). The HIGH tier has no series kernel and evaluates the scalar
+// function per element.
+template<CgammaPrecision P = CGAMMA_STANDARD>
+void cgamma_batch(const std::complex<double>* in,
+		  std::complex<double>* out, std::size_t len);
+template<CgammaPrecision P = CGAMMA_STANDARD>
+void clgamma_batch(const std::complex<double>* in,
+		   std::complex<double>* out, std::size_t len);
+template<> void cgamma_batch<CGAMMA_HIGH>(const std::complex<double>* in,
+					  std::complex<double>* out,
+					  std::size_t len);
+template<> void clgamma_batch<CGAMMA_HIGH>(const std::complex<double>* in,
+					   std::complex<double>* out,
+					   std::size_t len);
+template<CgammaPrecision P = CGAMMA_STANDARD>
+void cgamma_real_batch(const double* in, double* out, std::size_t len);
+template<> void cgamma_real_batch<CGAMMA_HIGH>(const double* in, double* out,
+					       std::size_t len);
+const double CGAMMA_BATCH_ULP = 32.0;
+
+// Parallel versions of the batch functions above, with the
+// precision chosen at runtime: [0, len) is split into chunks of
+// CGAMMA_PARALLEL_GRAIN elements that are evaluated by up to nthreads
+// threads of the persistent pool in threadpool.h. Runs serially on the
+// calling thread when nthreads <= 1 or len < CGAMMA_PARALLEL_MIN.
+void cgamma_parallel(const std::complex<double>* in,
+		     std::complex<double>* out, std::size_t len,
+		     int nthreads,
+		     CgammaPrecision precision = CGAMMA_STANDARD);
+void clgamma_parallel(const std::complex<double>* in,
+		      std::complex<double>* out, std::size_t len,
+		      int nthreads,
+		      CgammaPrecision precision = CGAMMA_STANDARD);
+void cgamma_real_parallel(const double* in, double* out, std::size_t len,
+			  int nthreads,
+			  CgammaPrecision precision = CGAMMA_STANDARD);
+const std::size_t CGAMMA_PARALLEL_MIN = 16384;
+const std::size_t CGAMMA_PARALLEL_GRAIN = 8192;
+
+// Gamma over the grid z = re[i] + 1i*im[j], i < nre, j < nim, written
+// column-major (i varies fastest, as in R's outer(re, im)) without
+// forming z: arguments are generated in tiles that stay in cache and
+// evaluated by cgamma_batch(). out receives 2*nre*nim doubles (complex
+// values) for CGAMMA_GRID_COMPLEX, else nre*nim doubles holding |Gamma|
+// or arg(Gamma). Parallelized like cgamma_parallel().
+enum CgammaGridOutput {
+    CGAMMA_GRID_COMPLEX,
+    CGAMMA_GRID_MODULUS,
+    CGAMMA_GRID_PHASE
+};
+void cgamma_grid(const double* re, std::size_t nre,
+		 const double* im, std::size_t nim, double* out,
+		 CgammaGridOutput output, int nthreads,
+		 CgammaPrecision precision = CGAMMA_STANDARD);
+
+// Name of the series kernel used by cgamma_batch() ("avx512", "avx2"
+// or "scalar"). The best kernel supported by the CPU is selected the
+// first time it is needed; cgamma_set_kernel() overrides the choice
+// and returns false if the named kernel is not available.
+const char* cgamma_kernel_name();
+bool cgamma_set_kernel(const char* name);
+
+#endif
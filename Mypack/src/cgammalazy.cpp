@@ -0,0 +1,281 @@
+/**
+ * Lazy complex gamma vectors (ALTREP).
+ *
+ * cgammacpp_lazy() returns a complex vector whose elements are computed
+ * on first access, LAZY_BLOCK elements at a time, and cached per block.
+ * Element and region access (x[i], head(), subsetting, printing) only
+ * evaluates and stores the blocks it touches. Operations that need a
+ * pointer to the whole vector (arithmetic, abs(), .Call code using
+ * COMPLEX()) materialize it once, in parallel, after which the block
+ * cache is released. The input is read through the region interface,
+ * so an ALTREP input such as 1:1e9 is not expanded either.
+ *
+ * Cached blocks and the materialized vector hold identical values:
+ * LAZY_BLOCK and CGAMMA_PARALLEL_GRAIN are multiples of the batch
+ * kernels' block size, so every element sees the same instruction
+ * sequence on both paths.
+ */
+
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#if R_VERSION < R_Version(3, 6, 0)
+// R_ext/Altrep.h used 'class' as a parameter name and lacked C linkage
+// declarations before R 3.6.
+#define class klass
+extern "C" {
+#include <R_ext/Altrep.h>
+}
+#undef class
+#else
+#include <R_ext/Altrep.h>
+#endif
+
+#include "cgamma.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const R_xlen_t LAZY_BLOCK = 1024;
+
+struct LazyState {
+    R_xlen_t len;
+    CgammaPrecision precision;
+    int nthreads;
+    std::vector<std::unique_ptr<std::complex<double>[]> > blocks;
+    R_xlen_t computed;
+};
+
+R_altrep_class_t lazy_class;
+
+// data1: external pointer to the LazyState, protecting the input.
+// data2: R_NilValue, or the materialized CPLXSXP.
+LazyState* state(SEXP x) {
+    return static_cast<LazyState*>(R_ExternalPtrAddr(R_altrep_data1(x)));
+}
+
+SEXP input(SEXP x) {
+    return R_ExternalPtrProtected(R_altrep_data1(x));
+}
+
+void finalize_state(SEXP ptr) {
+    delete static_cast<LazyState*>(R_ExternalPtrAddr(ptr));
+    R_ClearExternalPtr(ptr);
+}
+
+// Reads in[start, start+n) into buf as complex numbers.
+void load_input(SEXP in, R_xlen_t start, R_xlen_t n,
+		std::complex<double>* buf) {
+    switch(TYPEOF(in)) {
+    case CPLXSXP:
+	COMPLEX_GET_REGION(in, start, n, reinterpret_cast<Rcomplex*>(buf));
+	break;
+    case REALSXP: {
+	// Read into the front of buf and widen walking down, so no
+	// element is overwritten before it has been moved.
+	double* d = reinterpret_cast<double*>(buf);
+	REAL_GET_REGION(in, start, n, d);
+	for(R_xlen_t i = n - 1; i >= 0; --i) {
+	    d[2*i + 1] = 0.0;
+	    d[2*i] = d[i];
+	}
+	break;
+    }
+    default: {                  // INTSXP, checked by cgammacpp_lazy()
+	std::vector<int> v(n);
+	INTEGER_GET_REGION(in, start, n, v.data());
+	for(R_xlen_t i = 0; i < n; ++i)
+	    buf[i] = v[i] == NA_INTEGER ? NA_REAL : (double)v[i];
+    }
+    }
+}
+
+const std::complex<double>* block(SEXP x, R_xlen_t b) {
+    LazyState* s = state(x);
+    if(!s->blocks[b]) {
+	R_xlen_t start = b*LAZY_BLOCK;
+	R_xlen_t n = std::min(LAZY_BLOCK, s->len - start);
+	std::unique_ptr<std::complex<double>[]> v(new std::complex<double>[n]);
+	load_input(input(x), start, n, v.get());
+	cgamma_parallel(v.get(), v.get(), n, 1, s->precision);
+	s->blocks[b] = std::move(v);
+	++s->computed;
+    }
+    return s->blocks[b].get();
+}
+
+SEXP make_lazy(SEXP state_ptr) {
+    return R_new_altrep(lazy_class, state_ptr, R_NilValue);
+}
+
+// ALTREP methods
+
+R_xlen_t lazy_Length(SEXP x) {
+    return state(x)->len;
+}
+
+Rboolean lazy_Inspect(SEXP x, int pre, int deep, int pvec,
+		      void (*inspect_subtree)(SEXP, int, int, int)) {
+    LazyState* s = state(x);
+    Rprintf(" cgamma_lazy (len=%lld, %lld of %lld blocks computed%s)\n",
+	    (long long)s->len, (long long)s->computed,
+	    (long long)s->blocks.size(),
+	    R_altrep_data2(x) != R_NilValue ? ", materialized" : "");
+    return TRUE;
+}
+
+void* lazy_Dataptr(SEXP x, Rboolean writeable) {
+    SEXP full = R_altrep_data2(x);
+    if(full == R_NilValue) {
+	LazyState* s = state(x);
+	full = PROTECT(Rf_allocVector(CPLXSXP, s->len));
+	std::complex<double>* out = reinterpret_cast<std::complex<double>*>(COMPLEX(full));
+	load_input(input(x), 0, s->len, out);
+	cgamma_parallel(out, out, s->len, s->nthreads, s->precision);
+	R_set_altrep_data2(x, full);
+	UNPROTECT(1);
+	// Every later access goes to the full vector.
+	std::vector<std::unique_ptr<std::complex<double>[]> >(s->blocks.size()).swap(s->blocks);
+	s->computed = 0;
+    }
+    return DATAPTR(full);
+}
+
+const void* lazy_Dataptr_or_null(SEXP x) {
+    SEXP full = R_altrep_data2(x);
+    return full == R_NilValue ? NULL : DATAPTR(full);
+}
+
+Rcomplex lazy_Elt(SEXP x, R_xlen_t i) {
+    SEXP full = R_altrep_data2(x);
+    if(full != R_NilValue)
+	return COMPLEX(full)[i];
+    std::complex<double> v = block(x, i/LAZY_BLOCK)[i % LAZY_BLOCK];
+    Rcomplex r;
+    r.r = v.real();
+    r.i = v.imag();
+    return r;
+}
+
+R_xlen_t lazy_Get_region(SEXP x, R_xlen_t i, R_xlen_t n, Rcomplex* buf) {
+    SEXP full = R_altrep_data2(x);
+    R_xlen_t len = state(x)->len;
+    n = std::min(n, len - i);
+    if(full != R_NilValue) {
+	std::copy(COMPLEX(full) + i, COMPLEX(full) + i + n, buf);
+	return n;
+    }
+    std::complex<double>* out = reinterpret_cast<std::complex<double>*>(buf);
+    for(R_xlen_t k = i; k < i + n; ) {
+	R_xlen_t b = k/LAZY_BLOCK, off = k % LAZY_BLOCK;
+	R_xlen_t m = std::min(LAZY_BLOCK - off, i + n - k);
+	const std::complex<double>* v = block(x, b);
+	std::copy(v + off, v + off + m, out + (k - i));
+	k += m;
+    }
+    return n;
+}
+
+// An unmaterialized copy shares the (immutable) block cache. Once
+// materialized the vector may have been modified through its data
+// pointer, so R's default duplication and serialization are used.
+SEXP lazy_Duplicate(SEXP x, Rboolean deep) {
+    if(R_altrep_data2(x) != R_NilValue)
+	return NULL;
+    return make_lazy(R_altrep_data1(x));
+}
+
+SEXP lazy_Serialized_state(SEXP x) {
+    if(R_altrep_data2(x) != R_NilValue)
+	return NULL;
+    LazyState* s = state(x);
+    return Rcpp::List::create(input(x), (int)s->precision, s->nthreads);
+}
+
+SEXP new_lazy(SEXP in, CgammaPrecision precision, int nthreads);
+
+SEXP lazy_Unserialize(SEXP cls, SEXP st) {
+    return new_lazy(VECTOR_ELT(st, 0),
+		    (CgammaPrecision)INTEGER(VECTOR_ELT(st, 1))[0],
+		    INTEGER(VECTOR_ELT(st, 2))[0]);
+}
+
+SEXP new_lazy(SEXP in, CgammaPrecision precision, int nthreads) {
+    LazyState* s = new LazyState;
+    s->len = XLENGTH(in);
+    s->precision = precision;
+    s->nthreads = nthreads;
+    s->blocks.resize((s->len + LAZY_BLOCK - 1)/LAZY_BLOCK);
+    s->computed = 0;
+    // The values are read lazily, so later assignments to the input
+    // must copy it rather than modify it in place.
+    MARK_NOT_MUTABLE(in);
+    SEXP ptr = PROTECT(R_MakeExternalPtr(s, R_NilValue, in));
+    R_RegisterCFinalizerEx(ptr, finalize_state, TRUE);
+    SEXP x = PROTECT(make_lazy(ptr));
+    UNPROTECT(2);
+    return x;
+}
+
+} // namespace
+
+// [[Rcpp::init]]
+void cgamma_lazy_init(DllInfo* dll) {
+    lazy_class = R_make_altcomplex_class("cgamma_lazy", "Mypack", dll);
+    R_set_altrep_Length_method(lazy_class, lazy_Length);
+    R_set_altrep_Inspect_method(lazy_class, lazy_Inspect);
+    R_set_altrep_Duplicate_method(lazy_class, lazy_Duplicate);
+    R_set_altrep_Serialized_state_method(lazy_class, lazy_Serialized_state);
+    R_set_altrep_Unserialize_method(lazy_class, lazy_Unserialize);
+    R_set_altvec_Dataptr_method(lazy_class, lazy_Dataptr);
+    R_set_altvec_Dataptr_or_null_method(lazy_class, lazy_Dataptr_or_null);
+    R_set_altcomplex_Elt_method(lazy_class, lazy_Elt);
+    R_set_altcomplex_Get_region_method(lazy_class, lazy_Get_region);
+}
+
+//' @title Lazily evaluated complex gamma function.
+//' @param inRvec integer, numeric or complex vector or matrix
+//' @param nthreads number of threads used if the whole vector is
+//' materialized.
+//' @param precision accuracy tier, as for \code{cgammacpp}.
+//' @details Returns an ALTREP complex vector with the attributes of
+//' \code{inRvec}. Elements are evaluated when first read, in blocks of
+//' 1024, and cached, so subsetting or printing part of a large result
+//' costs only the blocks involved. Functions that need the whole
+//' vector at once (arithmetic, \code{abs()}) evaluate it once in full.
+//' @return Returns a complex vector or matrix.
+// [[Rcpp::export()]]
+SEXP cgammacpp_lazy(SEXP inRvec, int nthreads = 1,
+		    std::string precision = "standard") {
+    CgammaPrecision prec = CGAMMA_STANDARD;
+    if(!cgamma_parse_precision(precision.c_str(), &prec))
+	Rcpp::stop("precision must be one of \"fast\", \"standard\" or \"high\"");
+    int type = TYPEOF(inRvec);
+    if(type != CPLXSXP && type != REALSXP && type != INTSXP)
+	Rcpp::stop("'inRvec' must be an integer, numeric or complex vector");
+    SEXP x = PROTECT(new_lazy(inRvec, prec, nthreads));
+    SHALLOW_DUPLICATE_ATTRIB(x, inRvec);
+    UNPROTECT(1);
+    return x;
+}
+
+//' @title Evaluation state of a \code{cgamma_lazy} vector.
+//' @param x vector returned by \code{cgamma_lazy}
+//' @return Returns a list with the length, the block size, the number
+//' of blocks and how many of them have been computed, and whether the
+//' vector has been materialized in full.
+// [[Rcpp::export()]]
+Rcpp::List cgammalazyinfo(SEXP x) {
+    if(!ALTREP(x) || !R_altrep_inherits(x, lazy_class))
+	Rcpp::stop("'x' is not a cgamma_lazy vector");
+    LazyState* s = state(x);
+    return Rcpp::List::create(Rcpp::Named("length") = (double)s->len,
+			      Rcpp::Named("block_size") = (int)LAZY_BLOCK,
+			      Rcpp::Named("blocks") = (double)s->blocks.size(),
+			      Rcpp::Named("computed") = (double)s->computed,
+			      Rcpp::Named("materialized") =
+			      R_altrep_data2(x) != R_NilValue);
+}
@@ -5,41 +5,140 @@
 #include <Rcpp.h>
 using namespace Rcpp;
 
-// More p's can be included for increased accuracy.
-static double pi = 3.14159265358979323846264338327950288;
-static double p[] = {0.99999999999980993, 676.5203681218851, 
-		     -1259.1392167224028, 771.32342877765313, 
-		     -176.61502916214059, 12.507343278686905,
-		     -0.13857109526572012, 9.9843695780195716e-6, 
-		     1.5056327351493116e-7 };
-
-// Complex gamma function using Lanczos approximation (see Wikipedia).
-// Uses the reflection formula: Gamma(z) Gamma(1-z) = pi/sin(pi*z) when
-// Re(z) < 0.5. Internal function of a single complex argument.
-std::complex<double> cgamma(std::complex<double> z) {
-
-    int g = 7;
-
-    // Reflection formula: Gamma(1-z) Gamma(z) = pi/sin(pi z).
-    if(z.real() < 0.5)
-	return pi/(sin(pi*z)*cgamma(1.0-z));
-
-    z -= 1;
-    std::complex<double> x = p[0];
-    for(int i = 1; i < g+2; ++i) {
-	x += p[i]/(z+(double)i);
+#include "cgamma.h"
+#include "resultcache.h"
+
+#include <functional>
+
+// Maps the precision argument of the R functions to an accuracy tier.
+static CgammaPrecision cgamma_precision(const std::string& precision) {
+    CgammaPrecision prec = CGAMMA_STANDARD;
+    if(!cgamma_parse_precision(precision.c_str(), &prec))
+	Rcpp::stop("precision must be one of \"fast\", \"standard\" or \"high\"");
+    return prec;
+}
+
+// Evaluates cgamma over the complex vector x, overwriting its values.
+static void cgamma_overwrite(SEXP x, int nthreads,
+			     CgammaPrecision precision = CGAMMA_STANDARD) {
+    std::complex<double>* xCptr = reinterpret_cast<std::complex<double>*>(COMPLEX(x));
+    cgamma_parallel(xCptr, xCptr, XLENGTH(x), nthreads, precision);
+}
+
+// Result kinds for the result cache, combined with the precision (and
+// the grid output) so that each distinct computation has its own key.
+enum CacheKind {
+    CACHE_GAMMA,                // complex kernel
+    CACHE_GAMMA_REAL,           // real kernel, numeric output
+    CACHE_GAMMA_REAL_CPLX,      // real kernel, complex output
+    CACHE_LGAMMA,
+    CACHE_GRID
+};
+
+static unsigned cache_kind(CacheKind kind, CgammaPrecision precision,
+			   int extra = 0) {
+    return ((unsigned)kind << 8) | ((unsigned)precision << 4) | (unsigned)extra;
+}
+
+// Runs compute(), which writes out_bytes bytes to out from the input
+// bytes in (and in2, for grids), unless the result cache holds the
+// output for the same input. in may alias out: the key is computed
+// before compute() runs.
+static void cached_eval(unsigned kind, const void* in, std::size_t in_bytes,
+			const void* in2, std::size_t in2_bytes,
+			void* out, std::size_t out_bytes,
+			const std::function<void()>& compute) {
+    ResultCache& cache = ResultCache::instance();
+    if(!cache.enabled()) {
+	compute();
+	return;
+    }
+    ResultCache::Key key = ResultCache::key(kind, in, in_bytes, in2, in2_bytes);
+    if(cache.lookup(key, out, out_bytes))
+	return;
+    compute();
+    cache.insert(key, out, out_bytes);
+}
+
+// True when every element of x has a zero imaginary part.
+static bool all_real(const std::complex<double>* x, R_xlen_t len) {
+    for(R_xlen_t i = 0; i < len; ++i)
+	if(x[i].imag() != 0.0)
+	    return false;
+    return true;
+}
+
+// Evaluates the real kernel over the complex vector x, whose imaginary
+// parts are all zero, overwriting its values. The real parts are first
+// packed into the upper half of the buffer (walking down, so nothing is
+// overwritten before it is read), evaluated there, and widened back
+// walking up, so no scratch vector is needed.
+static void cgamma_real_overwrite(SEXP x, int nthreads,
+				  CgammaPrecision precision) {
+    R_xlen_t len = XLENGTH(x);
+    double* d = reinterpret_cast<double*>(COMPLEX(x));
+    for(R_xlen_t i = len - 1; i >= 0; --i)
+	d[len + i] = d[2*i];
+    cgamma_real_parallel(d + len, d + len, len, nthreads, precision);
+    for(R_xlen_t i = 0; i < len; ++i) {
+	d[2*i] = d[len + i];
+	d[2*i + 1] = 0.0;
     }
-    std::complex<double> t = z + 0.5 + (double)g;
-    return sqrt(2*pi)*pow(t,z+0.5)*exp(-t)*x;
 }
 
 //' @title R interface to complex gamma function.
 //' @param inRvec complex vector or 2d matrix of complex numbers
-//' @details The `Rcomplex` data structure definition has changed
-//' recently in `R_ext/Complex.h`.
-//' @return Returns a vector or matrix of complex values.
+//' @param nthreads number of threads used for the evaluation. Inputs
+//' shorter than 16384 elements are always evaluated serially.
+//' @param precision accuracy tier: "fast" (Lanczos, g=5, relative
+//' error about 1e-10), "standard" (Lanczos, g=7, about 1e-15) or
+//' "high" (Stirling series for |z| >= 10, "standard" elsewhere).
+//' @param complex type of the result for real-valued input: \code{NULL}
+//' (the default) returns a complex result for complex input and a
+//' numeric one for numeric input, \code{TRUE} always returns complex
+//' values, and \code{FALSE} also returns numeric values for complex
+//' input whose imaginary parts are all zero.
+//' @details Numeric input, and complex input whose imaginary parts are
+//' all zero, is evaluated with a real-arithmetic version of the same
+//' Lanczos kernel, which is about twice as fast as the complex one.
+//' The `Rcomplex` data structure definition has changed
+//' recently in `R_ext/Complex.h`. Worker threads only see raw
+//' pointers to the input and output data; the R API is used on the
+//' calling thread only.
+//' @return Returns a vector or matrix of complex (or numeric, see
+//' \code{complex}) values.
 // [[Rcpp::export()]]
-SEXP cgammacpp(SEXP inRvec) {
+SEXP cgammacpp(SEXP inRvec, int nthreads = 1,
+	       std::string precision = "standard", SEXP complex = R_NilValue) {
+
+    CgammaPrecision prec = cgamma_precision(precision);
+
+    bool cplx_in = TYPEOF(inRvec) == CPLXSXP;
+    bool real_valued = !cplx_in ||
+	all_real(reinterpret_cast<std::complex<double>*>(COMPLEX(inRvec)),
+		 XLENGTH(inRvec));
+    bool cplx_out = Rf_isNull(complex) ? cplx_in : Rcpp::as<bool>(complex);
+
+    if(real_valued && !cplx_out) {
+	// Coercion copies all but REALSXP input; the result keeps the
+	// attributes of the input either way.
+	Rcpp::NumericVector out_nv(inRvec);
+	if(TYPEOF(inRvec) == REALSXP)
+	    out_nv = Rcpp::clone(out_nv);
+	double* x = out_nv.begin();
+	std::size_t bytes = out_nv.size()*sizeof(double);
+	cached_eval(cache_kind(CACHE_GAMMA_REAL, prec), x, bytes, 0, 0, x, bytes,
+		    [&] { cgamma_real_parallel(x, x, out_nv.size(), nthreads, prec); });
+	return out_nv;
+    }
+    if(real_valued) {
+	Rcpp::ComplexVector out_cv(cplx_in ? Rf_duplicate(inRvec) : inRvec);
+	Rcomplex* x = COMPLEX(out_cv);
+	std::size_t bytes = out_cv.size()*sizeof(Rcomplex);
+	cached_eval(cache_kind(CACHE_GAMMA_REAL_CPLX, prec), x, bytes, 0, 0,
+		    x, bytes, [&] { cgamma_real_overwrite(out_cv, nthreads, prec); });
+	return out_cv;
+    }
 
     Rcpp::ComplexVector in_cv, out_cv;
     Rcpp::ComplexMatrix in_cm, out_cm;
@@ -67,11 +166,239 @@ SEXP cgammacpp(SEXP inRvec) {
     std::complex<double>* outCptr = reinterpret_cast<std::complex<double>*>(outRptr);
 
     // Do the computations and return the output ComplexVector.
-    std::transform(&inCptr[0], &inCptr[len], &outCptr[0], cgamma);
+    std::size_t bytes = len*sizeof(Rcomplex);
+    cached_eval(cache_kind(CACHE_GAMMA, prec), inCptr, bytes, 0, 0,
+		outCptr, bytes,
+		[&] { cgamma_parallel(inCptr, outCptr, len, nthreads, prec); });
 
     return Rf_isMatrix(inRvec) ? out_cm : out_cv;
 }
 
+//' @title R interface to the complex log-gamma function.
+//' @param inRvec numeric or complex vector or 2d matrix
+//' @param nthreads number of threads used for the evaluation.
+//' @param precision accuracy tier, as for \code{cgammacpp}.
+//' @details log Gamma(z) is computed without forming Gamma(z), so it
+//' stays finite where \code{cgammacpp} overflows (for example
+//' Re(z) > 171). In the right half-plane the result is the analytic
+//' continuation of \code{lgamma}; in the left half-plane its imaginary
+//' part is determined only modulo 2 pi.
+//' @return Returns a complex vector or matrix with the dimensions of
+//' \code{inRvec}.
+// [[Rcpp::export()]]
+SEXP clgammacpp(SEXP inRvec, int nthreads = 1,
+		std::string precision = "standard") {
+
+    CgammaPrecision prec = cgamma_precision(precision);
+
+    // Coerce (or duplicate) into a new complex vector that keeps the
+    // attributes of the input, then evaluate in place.
+    Rcpp::ComplexVector out_cv(TYPEOF(inRvec) == CPLXSXP ?
+			       Rf_duplicate(inRvec) : inRvec);
+    std::complex<double>* outCptr = reinterpret_cast<std::complex<double>*>(COMPLEX(out_cv));
+    std::size_t bytes = out_cv.size()*sizeof(Rcomplex);
+    cached_eval(cache_kind(CACHE_LGAMMA, prec), outCptr, bytes, 0, 0,
+		outCptr, bytes, [&] {
+	clgamma_parallel(outCptr, outCptr, out_cv.size(), nthreads, prec);
+    });
+    return out_cv;
+}
+
+//' @title Complex gamma function over a grid.
+//' @param re real parts (rows of the result)
+//' @param im imaginary parts (columns of the result)
+//' @param output "complex" for Gamma(z), or "modulus" or "phase" for
+//' only abs() or Arg() of it.
+//' @param nthreads number of threads used for the evaluation.
+//' @param precision accuracy tier, as for \code{cgammacpp}.
+//' @details Equivalent to \code{cgammacpp} of the matrix
+//' \code{outer(re, im, function(x, y) complex(real = x, imaginary = y))}
+//' (followed by \code{abs()} or \code{Arg()} for the other outputs),
+//' but the matrix of arguments is never formed: they
+//' are generated in cache-sized tiles as the kernel consumes them, and
+//' the modulus and phase outputs are numeric, half the size of the
+//' complex result.
+//' @return Returns a \code{length(re)} by \code{length(im)} complex
+//' or numeric matrix.
+// [[Rcpp::export()]]
+SEXP cgammacpp_grid(Rcpp::NumericVector re, Rcpp::NumericVector im,
+		    std::string output = "complex", int nthreads = 1,
+		    std::string precision = "standard") {
+
+    CgammaPrecision prec = cgamma_precision(precision);
+    int nre = re.size(), nim = im.size();
+
+    // Both axes are hashed for the result cache.
+    auto eval = [&](double* out, CgammaGridOutput mode, std::size_t bytes) {
+	cached_eval(cache_kind(CACHE_GRID, prec, mode),
+		    re.begin(), nre*sizeof(double), im.begin(), nim*sizeof(double),
+		    out, bytes, [&] {
+	    cgamma_grid(re.begin(), nre, im.begin(), nim, out, mode,
+			nthreads, prec);
+	});
+    };
+
+    if(output == "complex") {
+	Rcpp::ComplexMatrix out(nre, nim);
+	eval(reinterpret_cast<double*>(COMPLEX(out)), CGAMMA_GRID_COMPLEX,
+	     (std::size_t)nre*nim*sizeof(Rcomplex));
+	return out;
+    }
+    CgammaGridOutput mode = CGAMMA_GRID_MODULUS;
+    if(output == "phase")
+	mode = CGAMMA_GRID_PHASE;
+    else if(output != "modulus")
+	Rcpp::stop("output must be one of \"complex\", \"modulus\" or \"phase\"");
+    Rcpp::NumericMatrix out(nre, nim);
+    eval(out.begin(), mode, (std::size_t)nre*nim*sizeof(double));
+    return out;
+}
+
+//' @title In-place complex gamma function.
+//' @param inRvec complex vector or matrix of complex numbers
+//' @param nthreads number of threads used for the evaluation.
+//' @details When \code{inRvec} is a complex vector that is not shared
+//' (its NAMED/reference count shows no other binding, as for the
+//' result of an expression passed directly) the values are overwritten
+//' and \code{inRvec} itself is returned, so no second vector of the
+//' same size is allocated. Shared vectors, such as a variable passed by
+//' name, keep value semantics and are evaluated by \code{cgammacpp}.
+//' Numeric input is converted into a single new complex vector.
+//' @return Returns a vector or matrix of complex values with the
+//' attributes of the input.
+// [[Rcpp::export()]]
+SEXP cgammacpp_inplace(SEXP inRvec, int nthreads = 1) {
+    if(TYPEOF(inRvec) == CPLXSXP && !MAYBE_SHARED(inRvec)) {
+	std::complex<double>* xCptr = reinterpret_cast<std::complex<double>*>(COMPLEX(inRvec));
+	if(all_real(xCptr, XLENGTH(inRvec)))
+	    cgamma_real_overwrite(inRvec, nthreads, CGAMMA_STANDARD);
+	else
+	    cgamma_overwrite(inRvec, nthreads);
+	return inRvec;
+    }
+    return cgammacpp(inRvec, nthreads, "standard", Rcpp::wrap(true));
+}
+
+//' @title Complex gamma function into a caller-supplied vector.
+//' @param inRvec numeric (double or integer) or complex vector or matrix
+//' @param out complex vector of the same length as \code{inRvec}
+//' that receives the result. It may be \code{inRvec} itself.
+//' @param nthreads number of threads used for the evaluation.
+//' @details \code{out} is modified by reference, even when it is
+//' bound to other variables, so it should be a vector owned by the
+//' caller (for example one preallocated with \code{complex(n)} and
+//' reused across calls). \code{cgammacpp_into(z, z)} overwrites
+//' \code{z} without allocating anything.
+//' @return Returns \code{out}.
+// [[Rcpp::export()]]
+SEXP cgammacpp_into(SEXP inRvec, SEXP out, int nthreads = 1) {
+
+    if(TYPEOF(out) != CPLXSXP)
+	Rcpp::stop("'out' must be a complex vector");
+    R_xlen_t len = XLENGTH(out);
+    if(XLENGTH(inRvec) != len)
+	Rcpp::stop("'out' must have the same length as 'inRvec'");
+
+    std::complex<double>* outCptr = reinterpret_cast<std::complex<double>*>(COMPLEX(out));
+    switch(TYPEOF(inRvec)) {
+    case CPLXSXP:
+	cgamma_parallel(reinterpret_cast<std::complex<double>*>(COMPLEX(inRvec)),
+			outCptr, len, nthreads);
+	break;
+    case INTSXP:
+    case REALSXP: {
+	// Evaluate into the upper half of out, then widen in place (see
+	// cgamma_real_overwrite()). Integers are converted there first.
+	double* d = reinterpret_cast<double*>(outCptr);
+	const double* x = TYPEOF(inRvec) == REALSXP ? REAL(inRvec) : d + len;
+	if(TYPEOF(inRvec) == INTSXP) {
+	    const int* iv = INTEGER(inRvec);
+	    for(R_xlen_t i = 0; i < len; ++i)
+		d[len + i] = iv[i] == NA_INTEGER ? NA_REAL : (double)iv[i];
+	}
+	cgamma_real_parallel(x, d + len, len, nthreads);
+	for(R_xlen_t i = 0; i < len; ++i) {
+	    d[2*i] = d[len + i];
+	    d[2*i + 1] = 0.0;
+	}
+	break;
+    }
+    default:
+	Rcpp::stop("'inRvec' must be a numeric or complex vector");
+    }
+    return out;
+}
+
+// Returns the counters and sizes of the result cache as an R list.
+static Rcpp::List cache_stats() {
+    ResultCache::Stats st = ResultCache::instance().stats();
+    return Rcpp::List::create(Rcpp::Named("hits") = (double)st.hits,
+			      Rcpp::Named("spill_hits") = (double)st.spill_hits,
+			      Rcpp::Named("misses") = (double)st.misses,
+			      Rcpp::Named("insertions") = (double)st.insertions,
+			      Rcpp::Named("evictions") = (double)st.evictions,
+			      Rcpp::Named("spills") = (double)st.spills,
+			      Rcpp::Named("entries") = (double)st.entries,
+			      Rcpp::Named("mb") = st.bytes/1048576.0,
+			      Rcpp::Named("spill_entries") = (double)st.spill_entries,
+			      Rcpp::Named("spill_mb") = st.spill_bytes/1048576.0);
+}
+
+//' @title Configure the result cache used by \code{cgammacpp}
+//' @param enable \code{FALSE} disables the cache and discards its
+//' contents.
+//' @param max_mb memory limit for cached results, in megabytes.
+//' @param spill_dir directory that receives results evicted from
+//' memory, or "" to discard them.
+//' @param spill_max_mb limit on the size of the spilled results.
+//' @details Results of \code{cgammacpp}, \code{clgammacpp} and
+//' \code{cgammacpp_grid} are keyed by a 128-bit hash of the input
+//' values together with the function, precision and output type, and
+//' evicted least recently used first. Spilled results are read back
+//' through a memory mapping and moved back into memory when hit. The
+//' in-place variants bypass the cache.
+//' @return Returns the cache statistics, as \code{cgammacachestats}.
+// [[Rcpp::export()]]
+Rcpp::List cgammacpp_cache(bool enable = true, double max_mb = 256,
+			   std::string spill_dir = "",
+			   double spill_max_mb = 1024) {
+    if(enable && !(max_mb > 0))
+	Rcpp::stop("'max_mb' must be positive");
+    ResultCache::instance().configure(enable ? (std::size_t)(max_mb*1048576) : 0,
+				      spill_dir,
+				      (std::size_t)(spill_max_mb*1048576));
+    return cache_stats();
+}
+
+//' @title Result cache statistics
+//' @param reset set the counters back to zero after reading them.
+//' @return Returns a list with the number of hits (in memory and from
+//' spill files), misses, insertions, evictions and spills, and the
+//' number and size in megabytes of the entries held in memory and on
+//' disk.
+// [[Rcpp::export()]]
+Rcpp::List cgammacachestats(bool reset = false) {
+    Rcpp::List st = cache_stats();
+    if(reset)
+	ResultCache::instance().reset_stats();
+    return st;
+}
+
+//' @title Select the series kernel used by \code{cgammacpp}
+//' @param kernel name of the kernel to use ("avx512", "avx2" or
+//' "scalar"), or "" to leave the current selection unchanged.
+//' @details By default the fastest kernel supported by the CPU is
+//' selected at runtime. All kernels evaluate the same Lanczos series,
+//' and agree with the scalar reference to within the bound documented
+//' in \code{cgammabatch.cpp}.
+//' @return Returns the name of the kernel in use.
+// [[Rcpp::export()]]
+Rcpp::CharacterVector cgammakernel(std::string kernel = "") {
+    if(!kernel.empty() && !cgamma_set_kernel(kernel.c_str()))
+	Rcpp::stop("kernel '" + kernel + "' is not available on this CPU");
+    return cgamma_kernel_name();
+}
+
 // Optional function used to return compiler toolchain info...
 
 #define STRINGIFY(x) #x
@@ -0,0 +1,262 @@
+/**
+ * Content-hashed LRU result cache (see resultcache.h).
+ */
+
+#include "resultcache.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#define getpid _getpid
+#endif
+
+namespace {
+
+inline std::uint64_t rotl(std::uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// splitmix64 finalizer.
+inline std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Two independent multiply-rotate streams over 8-byte words; the
+// trailing bytes are zero-padded into a last word.
+void hash_bytes(const void* p, std::size_t n,
+		std::uint64_t& h1, std::uint64_t& h2) {
+    const unsigned char* c = static_cast<const unsigned char*>(p);
+    std::size_t nw = n/8;
+    for(std::size_t i = 0; i < nw; ++i) {
+	std::uint64_t w;
+	std::memcpy(&w, c + 8*i, 8);
+	h1 = rotl(h1 ^ (w*0x9e3779b97f4a7c15ULL), 31)*0xff51afd7ed558ccdULL;
+	h2 = rotl(h2 + (w ^ 0xc4ceb9fe1a85ec53ULL), 27)*0x87c37b91114253d5ULL;
+    }
+    if(n % 8) {
+	std::uint64_t w = 0;
+	std::memcpy(&w, c + 8*nw, n % 8);
+	h1 = rotl(h1 ^ (w*0x9e3779b97f4a7c15ULL), 31)*0xff51afd7ed558ccdULL;
+	h2 = rotl(h2 + (w ^ 0xc4ceb9fe1a85ec53ULL), 27)*0x87c37b91114253d5ULL;
+    }
+    h1 ^= mix(n);
+    h2 += mix(n ^ 0x5bd1e995ULL);
+}
+
+} // namespace
+
+ResultCache& ResultCache::instance() {
+    static ResultCache cache;
+    return cache;
+}
+
+ResultCache::ResultCache()
+    : max_bytes_m(0), bytes_m(0), spill_max_bytes_m(0), spill_bytes_m(0) {
+    reset_stats();
+}
+
+ResultCache::~ResultCache() {
+    clear_locked();
+}
+
+ResultCache::Key ResultCache::key(unsigned kind, const void* a,
+				  std::size_t na, const void* b,
+				  std::size_t nb) {
+    std::uint64_t h1 = mix(kind + 1), h2 = mix(~(std::uint64_t)kind);
+    hash_bytes(a, na, h1, h2);
+    if(b != 0)
+	hash_bytes(b, nb, h1, h2);
+    Key k = {mix(h1 ^ rotl(h2, 17)), mix(h2 + h1)};
+    return k;
+}
+
+void ResultCache::configure(std::size_t max_bytes,
+			    const std::string& spill_dir,
+			    std::size_t spill_max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    if(max_bytes == 0 || spill_dir != spill_dir_m)
+	clear_locked();
+    max_bytes_m = max_bytes;
+    spill_dir_m = max_bytes > 0 ? spill_dir : std::string();
+    spill_max_bytes_m = spill_dir_m.empty() ? 0 : spill_max_bytes;
+    evict_locked();
+    while(spill_bytes_m > spill_max_bytes_m)
+	drop_spill_locked(--spilled_m.end());
+}
+
+bool ResultCache::enabled() const {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    return max_bytes_m > 0;
+}
+
+bool ResultCache::lookup(const Key& k, void* out, std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    auto it = index_m.find(k);
+    if(it != index_m.end() && it->second->data.size() == bytes) {
+	entries_m.splice(entries_m.begin(), entries_m, it->second);
+	std::memcpy(out, it->second->data.data(), bytes);
+	++stats_m.hits;
+	return true;
+    }
+    auto sit = spill_index_m.find(k);
+    if(sit != spill_index_m.end() && sit->second->bytes == bytes &&
+       read_spill_locked(sit->second, out)) {
+	// Promote back into memory; the file is no longer needed.
+	drop_spill_locked(sit->second);
+	entries_m.push_front(Entry());
+	Entry& e = entries_m.front();
+	e.key = k;
+	e.data.assign(static_cast<unsigned char*>(out),
+		      static_cast<unsigned char*>(out) + bytes);
+	index_m[k] = entries_m.begin();
+	bytes_m += bytes;
+	evict_locked();
+	++stats_m.spill_hits;
+	return true;
+    }
+    ++stats_m.misses;
+    return false;
+}
+
+void ResultCache::insert(const Key& k, const void* data, std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    if(max_bytes_m == 0 || bytes > max_bytes_m || index_m.count(k))
+	return;
+    auto sit = spill_index_m.find(k);
+    if(sit != spill_index_m.end())
+	drop_spill_locked(sit->second);
+    entries_m.push_front(Entry());
+    Entry& e = entries_m.front();
+    e.key = k;
+    e.data.assign(static_cast<const unsigned char*>(data),
+		  static_cast<const unsigned char*>(data) + bytes);
+    index_m[k] = entries_m.begin();
+    bytes_m += bytes;
+    ++stats_m.insertions;
+    evict_locked();
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    clear_locked();
+}
+
+ResultCache::Stats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    Stats s = stats_m;
+    s.entries = entries_m.size();
+    s.bytes = bytes_m;
+    s.spill_entries = spilled_m.size();
+    s.spill_bytes = spill_bytes_m;
+    return s;
+}
+
+void ResultCache::reset_stats() {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    std::memset(&stats_m, 0, sizeof(stats_m));
+}
+
+// Evicts least recently used entries until the memory limit holds.
+void ResultCache::evict_locked() {
+    while(bytes_m > max_bytes_m && !entries_m.empty()) {
+	Entry& e = entries_m.back();
+	if(!spill_dir_m.empty())
+	    spill_locked(e);
+	bytes_m -= e.data.size();
+	index_m.erase(e.key);
+	entries_m.pop_back();
+	++stats_m.evictions;
+    }
+}
+
+void ResultCache::spill_locked(Entry& e) {
+    std::size_t bytes = e.data.size();
+    if(bytes > spill_max_bytes_m)
+	return;
+    while(spill_bytes_m + bytes > spill_max_bytes_m)
+	drop_spill_locked(--spilled_m.end());
+
+    // Processes forked from one R session (CRcpp --prefork) share its
+    // tempdir, so the name carries the process id: no process removes
+    // another's files. The file is written under a temporary name and
+    // renamed into place, so a file being read (through mmap) is never
+    // truncated; a reader keeps the file it opened.
+    char name[96];
+    std::snprintf(name, sizeof(name), "/cgamma-%ld-%016llx%016llx.bin",
+		  (long)getpid(), (unsigned long long)e.key.h1,
+		  (unsigned long long)e.key.h2);
+    std::string path = spill_dir_m + name;
+    std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if(f == 0)
+	return;
+    bool ok = std::fwrite(e.data.data(), 1, bytes, f) == bytes;
+    ok = std::fclose(f) == 0 && ok;
+#ifdef _WIN32
+    // rename() does not replace an existing file here.
+    if(ok)
+	std::remove(path.c_str());
+#endif
+    if(!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+	std::remove(tmp.c_str());
+	return;
+    }
+    SpillEntry s = {e.key, bytes, path};
+    spilled_m.push_front(s);
+    spill_index_m[e.key] = spilled_m.begin();
+    spill_bytes_m += bytes;
+    ++stats_m.spills;
+}
+
+bool ResultCache::read_spill_locked(SpillList::iterator it, void* out) {
+#ifndef _WIN32
+    int fd = open(it->path.c_str(), O_RDONLY);
+    if(fd < 0)
+	return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (std::size_t)st.st_size == it->bytes;
+    if(ok && it->bytes > 0) {
+	void* p = mmap(0, it->bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	ok = p != MAP_FAILED;
+	if(ok) {
+	    std::memcpy(out, p, it->bytes);
+	    munmap(p, it->bytes);
+	}
+    }
+    close(fd);
+    return ok;
+#else
+    std::FILE* f = std::fopen(it->path.c_str(), "rb");
+    if(f == 0)
+	return false;
+    bool ok = std::fread(out, 1, it->bytes, f) == it->bytes;
+    std::fclose(f);
+    return ok;
+#endif
+}
+
+void ResultCache::drop_spill_locked(SpillList::iterator it) {
+    std::remove(it->path.c_str());
+    spill_bytes_m -= it->bytes;
+    spill_index_m.erase(it->key);
+    spilled_m.erase(it);
+}
+
+void ResultCache::clear_locked() {
+    while(!spilled_m.empty())
+	drop_spill_locked(spilled_m.begin());
+    entries_m.clear();
+    index_m.clear();
+    bytes_m = 0;
+}
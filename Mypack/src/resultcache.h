@@ -0,0 +1,109 @@
+/**
+ * Memoization of kernel results keyed by the content of their input.
+ * Entries are kept in a least-recently-used list bounded in bytes;
+ * entries evicted from memory can optionally be spilled to files in a
+ * directory (normally R's session temporary directory) and are read
+ * back through a read-only memory mapping. Like the kernels, this code
+ * does not touch the R API.
+ */
+
+#ifndef MYPACK_RESULTCACHE_H
+#define MYPACK_RESULTCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ResultCache {
+public:
+    // 128-bit content hash of an input, together with a caller-chosen
+    // kind that distinguishes functions and parameters applied to the
+    // same data.
+    struct Key {
+	std::uint64_t h1, h2;
+	bool operator==(const Key& k) const { return h1 == k.h1 && h2 == k.h2; }
+    };
+
+    struct Stats {
+	std::uint64_t hits, spill_hits, misses, insertions, evictions, spills;
+	std::size_t entries, bytes, spill_entries, spill_bytes;
+    };
+
+    // Process-wide cache, disabled until configure() is called.
+    static ResultCache& instance();
+
+    ~ResultCache();
+
+    // Hash of kind, and of the bytes of a (and b, if given). The
+    // lengths are hashed too, so different splits of the same bytes
+    // between a and b give different keys.
+    static Key key(unsigned kind, const void* a, std::size_t na,
+		   const void* b = 0, std::size_t nb = 0);
+
+    // Enables the cache with a limit of max_bytes of results in memory
+    // (0 disables it and drops every entry). With a non-empty spill_dir,
+    // entries evicted from memory are written there, up to
+    // spill_max_bytes, instead of being discarded.
+    void configure(std::size_t max_bytes, const std::string& spill_dir,
+		   std::size_t spill_max_bytes);
+    bool enabled() const;
+
+    // Copies the cached result for k into out and returns true, if an
+    // entry of exactly bytes bytes exists (in memory or spilled).
+    bool lookup(const Key& k, void* out, std::size_t bytes);
+
+    // Stores a copy of the result for k. Results larger than the memory
+    // limit are not cached.
+    void insert(const Key& k, const void* data, std::size_t bytes);
+
+    // Drops all entries, removing spill files.
+    void clear();
+
+    Stats stats() const;
+    void reset_stats();
+
+private:
+    ResultCache();
+    ResultCache(const ResultCache&);
+    ResultCache& operator=(const ResultCache&);
+
+    struct KeyHash {
+	std::size_t operator()(const Key& k) const { return (std::size_t)k.h1; }
+    };
+    struct Entry {
+	Key key;
+	std::vector<unsigned char> data;
+    };
+    struct SpillEntry {
+	Key key;
+	std::size_t bytes;
+	std::string path;
+    };
+    typedef std::list<Entry> EntryList;
+    typedef std::list<SpillEntry> SpillList;
+
+    void evict_locked();
+    void spill_locked(Entry& e);
+    bool read_spill_locked(SpillList::iterator it, void* out);
+    void drop_spill_locked(SpillList::iterator it);
+    void clear_locked();
+
+    mutable std::mutex mutex_m;
+    std::size_t max_bytes_m, bytes_m;
+    std::string spill_dir_m;
+    std::size_t spill_max_bytes_m, spill_bytes_m;
+
+    // Most recently used first.
+    EntryList entries_m;
+    std::unordered_map<Key, EntryList::iterator, KeyHash> index_m;
+    SpillList spilled_m;
+    std::unordered_map<Key, SpillList::iterator, KeyHash> spill_index_m;
+
+    Stats stats_m;
+};
+
+#endif
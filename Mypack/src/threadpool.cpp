@@ -0,0 +1,176 @@
+/**
+ * Persistent worker pool (see threadpool.h).
+ */
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <new>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool()
+    : fn_m(0), len_m(0), grain_m(1), next_m(0), active_m(0), busy_m(0),
+      generation_m(0), stop_m(false) {
+#ifndef _WIN32
+    pthread_atfork(&ThreadPool::before_fork, &ThreadPool::after_fork_parent,
+		   &ThreadPool::after_fork_child);
+#endif
+}
+
+#ifndef _WIN32
+// A process forked with the pool running (CRcpp --prefork after a
+// warmup that used nthreads > 1) has none of its workers. The locks are
+// held across fork() so that none is left taken by a worker, and the
+// child starts over with an empty pool, grown again on first use.
+void ThreadPool::before_fork() {
+    ThreadPool& pool = instance();
+    pool.call_m.lock();
+    pool.mutex_m.lock();
+}
+
+void ThreadPool::after_fork_parent() {
+    ThreadPool& pool = instance();
+    pool.mutex_m.unlock();
+    pool.call_m.unlock();
+}
+
+void ThreadPool::after_fork_child() {
+    ThreadPool& pool = instance();
+    // The std::thread objects name threads of the parent: they can be
+    // neither joined nor destroyed, so they are set aside and leaked.
+    new std::vector<std::thread>(std::move(pool.threads_m));
+    pool.threads_m.clear();
+    // The condition variables may record waiters that do not exist
+    // here; they and the locks are made new.
+    new (&pool.work_cv_m) std::condition_variable;
+    new (&pool.done_cv_m) std::condition_variable;
+    new (&pool.mutex_m) std::mutex;
+    new (&pool.call_m) std::mutex;
+    pool.active_m = pool.busy_m = 0;
+}
+#endif
+
+ThreadPool::~ThreadPool() {
+    {
+	std::lock_guard<std::mutex> lock(mutex_m);
+	stop_m = true;
+    }
+    work_cv_m.notify_all();
+    for(std::size_t i = 0; i < threads_m.size(); ++i)
+	threads_m[i].join();
+}
+
+int ThreadPool::workers() const {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    return (int)threads_m.size();
+}
+
+// Called with call_m held, so no job is in flight.
+void ThreadPool::grow(int nworkers) {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    for(int id = (int)threads_m.size(); id < nworkers; ++id)
+	threads_m.push_back(std::thread(&ThreadPool::worker_loop, this, id));
+}
+
+// Claims chunks of the current job until none are left. Called with
+// mutex_m unlocked; the chunk counter is advanced under the lock, which
+// is cheap relative to a chunk of kernel work.
+void ThreadPool::run_chunks() {
+    for(;;) {
+	std::size_t begin, end;
+	{
+	    std::lock_guard<std::mutex> lock(mutex_m);
+	    if(next_m >= len_m || error_m)
+		return;
+	    begin = next_m;
+	    end = std::min(len_m, begin + grain_m);
+	    next_m = end;
+	}
+	try {
+	    (*fn_m)(begin, end);
+	} catch(...) {
+	    std::lock_guard<std::mutex> lock(mutex_m);
+	    if(!error_m)
+		error_m = std::current_exception();
+	}
+    }
+}
+
+void ThreadPool::worker_loop(int id) {
+    unsigned long seen = 0;
+    for(;;) {
+	{
+	    std::unique_lock<std::mutex> lock(mutex_m);
+	    work_cv_m.wait(lock, [&] {
+		return stop_m || (generation_m != seen && id < active_m);
+	    });
+	    if(stop_m)
+		return;
+	    seen = generation_m;
+	    ++busy_m;
+	}
+	run_chunks();
+	{
+	    std::lock_guard<std::mutex> lock(mutex_m);
+	    --busy_m;
+	}
+	done_cv_m.notify_one();
+    }
+}
+
+void ThreadPool::parallel_for(std::size_t len, std::size_t grain,
+			      int nthreads, const RangeFn& fn) {
+    if(grain == 0)
+	grain = 1;
+    // Workers live as long as the pool, so more than one per core would
+    // only pile up (options(Mypack.threads = 1e5) would start threads
+    // until std::thread fails).
+    static const int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::min(nthreads, max_threads);
+    std::size_t nchunks = (len + grain - 1)/grain;
+    int nworkers = (int)std::min<std::size_t>(nthreads > 1 ? nthreads - 1 : 0,
+					      nchunks > 0 ? nchunks - 1 : 0);
+    if(nworkers == 0) {
+	if(len > 0)
+	    fn(0, len);
+	return;
+    }
+
+    std::lock_guard<std::mutex> call_lock(call_m);
+    grow(nworkers);
+    {
+	std::lock_guard<std::mutex> lock(mutex_m);
+	fn_m = &fn;
+	len_m = len;
+	grain_m = grain;
+	next_m = 0;
+	active_m = nworkers;
+	error_m = std::exception_ptr();
+	++generation_m;
+    }
+    work_cv_m.notify_all();
+
+    run_chunks();
+
+    std::exception_ptr error;
+    {
+	std::unique_lock<std::mutex> lock(mutex_m);
+	// Workers that have not woken up yet must not join late, and the
+	// ones already running finish their last chunk.
+	active_m = 0;
+	done_cv_m.wait(lock, [&] { return busy_m == 0; });
+	fn_m = 0;
+	error = error_m;
+	error_m = std::exception_ptr();
+    }
+    if(error)
+	std::rethrow_exception(error);
+}
@@ -0,0 +1,69 @@
+/**
+ * Persistent pool of worker threads used to split element-wise kernels
+ * across cores. Workers never call into R: the R interface extracts raw
+ * pointers first, and only pure C++ kernels run on the pool.
+ */
+
+#ifndef MYPACK_THREADPOOL_H
+#define MYPACK_THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    typedef std::function<void(std::size_t, std::size_t)> RangeFn;
+
+    // Process-wide pool. Workers are started on first use and live
+    // until the library is unloaded; a forked child starts with none.
+    static ThreadPool& instance();
+
+    ~ThreadPool();
+
+    // Calls fn(begin, end) over consecutive chunks of [0, len) of at
+    // most grain elements, using up to nthreads threads (the calling
+    // thread included; at most one per core, as reported by
+    // std::thread::hardware_concurrency()). Blocks until every chunk is done, and rethrows
+    // the first exception raised by fn, if any.
+    void parallel_for(std::size_t len, std::size_t grain, int nthreads,
+		      const RangeFn& fn);
+
+    // Number of worker threads started so far (not counting the caller).
+    int workers() const;
+
+private:
+    ThreadPool();
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+#ifndef _WIN32
+    static void before_fork();
+    static void after_fork_parent();
+    static void after_fork_child();
+#endif
+
+    void grow(int nworkers);
+    void worker_loop(int id);
+    void run_chunks();
+
+    mutable std::mutex mutex_m;
+    std::condition_variable work_cv_m, done_cv_m;
+    std::vector<std::thread> threads_m;
+    std::mutex call_m;          // serializes parallel_for() callers
+
+    // Current job, guarded by mutex_m.
+    const RangeFn* fn_m;
+    std::size_t len_m, grain_m, next_m;
+    int active_m;               // workers allowed to join this job
+    int busy_m;                 // workers still inside run_chunks()
+    unsigned long generation_m;
+    std::exception_ptr error_m;
+    bool stop_m;
+};
+
+#endif
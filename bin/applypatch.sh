@@ -1,6 +1,9 @@
 #!/bin/sh
 # Patch Rcpp and RInside source files for use with Microsoft compiler.
-# Also includes a general patch for RInside.cpp. Microsoft changes
+# Also includes a general patch for RInside.cpp, and the CRcpp
+# additions to RInside (parse cache, input scanner,
+# executor thread, buffered console output, streaming console
+# input, step-wise REPL, zero-copy vectors). Microsoft changes
 # are indicated by _MSC_VER define.
 # Path to CRcpp directory should be specified.
 if [ "$1" = "" ]; then
@@ -13,4 +16,20 @@ cp patch/date.cpp   Rcpp/src/
 cp patch/Rcpp.h     Rcpp/inst/include/
 cp patch/RInsideCommon.h RInside/inst/include/
 cp patch/RInside.cpp     RInside/src/
+cp patch/RInside.h       RInside/inst/include/
+cp patch/ParseCache.h    RInside/inst/include/
+cp patch/ParseCache.cpp  RInside/src/
+cp patch/CodeScanner.h   RInside/inst/include/
+cp patch/CodeScanner.cpp RInside/src/
+cp patch/RInsideExecutor.h   RInside/inst/include/
+cp patch/RInsideExecutor.cpp RInside/src/
+cp patch/Callbacks.h     RInside/inst/include/
+cp patch/ConsoleSink.h   RInside/inst/include/
+cp patch/ConsoleSink.cpp RInside/src/
+cp patch/ConsoleInput.h  RInside/inst/include/
+cp patch/ConsoleInput.cpp RInside/src/
+cp patch/RInsideRepl.h   RInside/inst/include/
+cp patch/RInsideRepl.cpp RInside/src/
+cp patch/ExternalVector.h   RInside/inst/include/
+cp patch/ExternalVector.cpp RInside/src/
 
@@ -0,0 +1,106 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// CodeScanner.cpp: incremental completeness check of R code for RInside
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#include <CodeScanner.h>
+
+#include <cstring>
+
+static bool isNameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9') || c == '.' || c == '_' ||
+        (unsigned char)c >= 0x80;
+}
+
+void CodeScanner::reset() {
+    state_m = CODE;
+    depth_m = 0;
+    quote_m = 0;
+    escape_m = raw_prefix_m = ident_m = false;
+    raw_close_m = 0;
+    raw_dashes_m = raw_seen_m = 0;
+    last_m = 0;
+}
+
+void CodeScanner::scan(const char* text, std::size_t len) {
+    for (std::size_t i = 0; i < len; i++) {
+        char c = text[i];
+        switch (state_m) {
+        case CODE:
+            if (c == '#') {
+                state_m = COMMENT;
+            } else if (c == '"' || c == '\'') {
+                // r"(...)", R'[...]', r"--{...}--" and so on (R >= 4.0)
+                state_m = raw_prefix_m ? RAW_OPEN : STRING;
+                quote_m = c;
+                escape_m = false;
+                raw_dashes_m = 0;
+            } else if (c == '`') {
+                state_m = STRING;
+                quote_m = c;
+                escape_m = false;
+            } else if (c == '(' || c == '[' || c == '{') {
+                depth_m++;
+            } else if (c == ')' || c == ']' || c == '}') {
+                depth_m--;
+            }
+            raw_prefix_m = (c == 'r' || c == 'R') && !ident_m;
+            ident_m = isNameChar(c);
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != '#')
+                last_m = c;
+            break;
+        case COMMENT:
+            if (c == '\n')
+                state_m = CODE;
+            break;
+        case STRING:
+            if (escape_m)
+                escape_m = false;
+            else if (c == '\\')
+                escape_m = true;
+            else if (c == quote_m)
+                state_m = CODE;
+            break;
+        case RAW_OPEN:
+            if (c == '-') {
+                raw_dashes_m++;
+            } else if (c == '(' || c == '[' || c == '{') {
+                raw_close_m = c == '(' ? ')' : c == '[' ? ']' : '}';
+                state_m = RAW;
+            } else {
+                state_m = CODE;             // malformed, left to the parser
+            }
+            break;
+        case RAW:
+            if (c == raw_close_m) {
+                raw_seen_m = 0;
+                state_m = RAW_CLOSE;
+            }
+            break;
+        case RAW_CLOSE:
+            if (c == quote_m && raw_seen_m == raw_dashes_m)
+                state_m = CODE;
+            else if (c == '-' && raw_seen_m < raw_dashes_m)
+                raw_seen_m++;
+            else if (c == raw_close_m)
+                raw_seen_m = 0;
+            else
+                state_m = RAW;
+            break;
+        }
+    }
+}
+
+bool CodeScanner::complete() const {
+    if (state_m != CODE && state_m != COMMENT)
+        return false;
+    if (depth_m > 0)
+        return false;
+    // A trailing binary (or unary) operator continues on the next line.
+    // A comma does not at the top level (R reports a parse error there,
+    // and inside brackets depth_m already holds the line back).
+    return last_m == 0 || std::strchr("+-*/^<>=!&|~$@:?%", last_m) == NULL;
+}
@@ -0,0 +1,49 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// CodeScanner.h: incremental completeness check of R code for RInside
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#ifndef RINSIDE_CODESCANNER_H
+#define RINSIDE_CODESCANNER_H
+
+#include <cstddef>
+
+// Tracks just enough of R's lexical structure (brackets, strings, raw
+// strings, quoted names and comments) over text fed to it piece by
+// piece to tell when the text could be a complete expression. Each
+// piece is scanned once, so once R has reported a line incomplete,
+// parseEval() can hold back R_ParseVector on the continuation lines
+// until the accumulated input is plausibly complete, instead of parsing
+// the whole buffer again after every line. A line that starts new code
+// always goes to the parser, which is the only judge of errors in it
+// ('f(a b' leaves a bracket open, but is a parse error, not incomplete).
+//
+// complete() is false while a bracket or string is open, or the code
+// ends in an operator, and true otherwise. It is a hint only, and the
+// parser still has the last word (an unfinished 'function(x)' or
+// 'if (a)' passes the scanner).
+class CodeScanner {
+public:
+    CodeScanner() { reset(); }
+
+    void reset();
+    void scan(const char* text, std::size_t len);
+    bool complete() const;
+
+private:
+    enum State { CODE, COMMENT, STRING, RAW_OPEN, RAW, RAW_CLOSE };
+
+    State state_m;
+    int depth_m;                // open ( [ { less closed ones
+    char quote_m;               // delimiter of the current string
+    bool escape_m;              // previous string character was '\'
+    bool raw_prefix_m;          // previous code character is an r/R token
+    bool ident_m;               // previous code character is part of a name
+    char raw_close_m;           // ) ] or } closing the raw string
+    int raw_dashes_m, raw_seen_m;
+    char last_m;                // last code character that is not blank
+};
+
+#endif
@@ -0,0 +1,154 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// ConsoleInput.cpp: streaming console input for RInside
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#include <ConsoleInput.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+std::size_t ConsoleInput::lineLength(const char* p, std::size_t avail,
+                                     std::size_t room, bool eof) {
+    std::size_t n = std::min(avail, room);
+    const void* nl = memchr(p, '\n', n);
+    if (nl != NULL)
+        return static_cast<const char*>(nl) - p + 1;
+    return n == room || eof ? n : 0;
+}
+
+FdInput::FdInput(int fd, std::size_t bufsize)
+    : fd_m(fd), buf_m(bufsize > 0 ? bufsize : 1), begin_m(0), end_m(0),
+      eof_m(false) {
+}
+
+std::size_t FdInput::readLine(char* buf, std::size_t len) {
+    std::size_t room = len - 1, n;
+    while ((n = lineLength(&buf_m[begin_m], end_m - begin_m, room, eof_m)) == 0
+           && !eof_m) {
+        // Make space after the unread input, then read more.
+        if (end_m == buf_m.size()) {
+            if (begin_m > 0) {
+                memmove(&buf_m[0], &buf_m[begin_m], end_m - begin_m);
+                end_m -= begin_m;
+                begin_m = 0;
+            } else {
+                buf_m.resize(2*buf_m.size());   // only if room > bufsize
+            }
+        }
+#ifdef _WIN32
+        int got = ::read(fd_m, &buf_m[end_m], (unsigned)(buf_m.size() - end_m));
+#else
+        ssize_t got = ::read(fd_m, &buf_m[end_m], buf_m.size() - end_m);
+#endif
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            eof_m = true;
+        else
+            end_m += got;
+    }
+    memcpy(buf, &buf_m[begin_m], n);
+    buf[n] = '\0';
+    begin_m += n;
+    if (begin_m == end_m)
+        begin_m = end_m = 0;
+    return n;
+}
+
+MemoryInput::MemoryInput(const char* data, std::size_t size)
+    : pos_m(data), end_m(data + size) {
+}
+
+std::size_t MemoryInput::readLine(char* buf, std::size_t len) {
+    std::size_t n = lineLength(pos_m, end_m - pos_m, len - 1, true);
+    memcpy(buf, pos_m, n);
+    buf[n] = '\0';
+    pos_m += n;
+    return n;
+}
+
+RingInput::RingInput(std::size_t capacity)
+    : ring_m(capacity > 0 ? capacity : 1), head_m(0), size_m(0),
+      closed_m(false) {
+}
+
+bool RingInput::write(const char* data, std::size_t len) {
+    std::unique_lock<std::mutex> lock(mutex_m);
+    while (len > 0) {
+        writable_m.wait(lock, [this] { return closed_m || size_m < ring_m.size(); });
+        if (closed_m)
+            return false;
+        // At most up to the end of the ring, or of the free space.
+        std::size_t tail = (head_m + size_m) % ring_m.size();
+        std::size_t n = std::min(len, std::min(ring_m.size() - size_m,
+                                               ring_m.size() - tail));
+        memcpy(&ring_m[tail], data, n);
+        size_m += n;
+        data += n;
+        len -= n;
+        readable_m.notify_one();
+    }
+    return true;
+}
+
+void RingInput::close() {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    closed_m = true;
+    readable_m.notify_all();
+    writable_m.notify_all();
+}
+
+// Offset of the first c among the first limit unread bytes, or limit.
+std::size_t RingInput::find(char c, std::size_t limit) const {
+    std::size_t first = std::min(limit, ring_m.size() - head_m);
+    const void* p = memchr(&ring_m[head_m], c, first);
+    if (p != NULL)
+        return static_cast<const char*>(p) - &ring_m[head_m];
+    if (first < limit) {
+        p = memchr(&ring_m[0], c, limit - first);
+        if (p != NULL)
+            return first + (static_cast<const char*>(p) - &ring_m[0]);
+    }
+    return limit;
+}
+
+void RingInput::copyOut(char* buf, std::size_t n) {
+    std::size_t first = std::min(n, ring_m.size() - head_m);
+    memcpy(buf, &ring_m[head_m], first);
+    memcpy(buf + first, &ring_m[0], n - first);
+    head_m = (head_m + n) % ring_m.size();
+    size_m -= n;
+}
+
+std::size_t RingInput::readLine(char* buf, std::size_t len) {
+    std::size_t room = len - 1, n = 0;
+    std::unique_lock<std::mutex> lock(mutex_m);
+    for (;;) {
+        std::size_t limit = std::min(size_m, room);
+        std::size_t nl = find('\n', limit);
+        if (nl < limit) {
+            n = nl + 1;
+            break;
+        }
+        // A line longer than R's buffer, or than the ring, goes in pieces.
+        if (limit == room || size_m == ring_m.size() || closed_m) {
+            n = limit;
+            break;
+        }
+        readable_m.wait(lock);
+    }
+    copyOut(buf, n);
+    buf[n] = '\0';
+    writable_m.notify_all();
+    return n;
+}
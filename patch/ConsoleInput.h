@@ -0,0 +1,91 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// ConsoleInput.h: streaming console input for RInside
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#ifndef RINSIDE_CONSOLEINPUT_H
+#define RINSIDE_CONSOLEINPUT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// A source of console input for R's REPL, read straight into the buffer
+// R passes to its ReadConsole hook. Each call of readLine() copies the
+// next line, or as much of it as fits, so a line longer than R's buffer
+// arrives over several calls instead of being cut short. R's own
+// console reader (fgets on stdin) splits long lines the same way.
+//
+// Install one with RInside::setConsoleInput(), or with
+// Callbacks::setConsoleInput() when callbacks are in use.
+class ConsoleInput {
+public:
+    virtual ~ConsoleInput() {}
+
+    // Copies the next line (up to and including its newline), or its
+    // next len - 1 bytes if it is longer, into buf and terminates it
+    // with a NUL. Returns the number of bytes copied: 0 at the end of
+    // the input. len must be at least 2.
+    virtual std::size_t readLine(char* buf, std::size_t len) = 0;
+
+protected:
+    // Length of the piece of p[0, avail) readLine() hands out when at
+    // most room bytes fit; 0 if the piece is not all there yet (no
+    // newline, and fewer than room bytes) unless at the end of input.
+    static std::size_t lineLength(const char* p, std::size_t avail,
+                                  std::size_t room, bool eof);
+};
+
+// Input read from a file descriptor (a pipe, a file, a socket), through
+// a buffer of its own. The descriptor is not closed.
+class FdInput : public ConsoleInput {
+public:
+    explicit FdInput(int fd, std::size_t bufsize = 65536);
+    std::size_t readLine(char* buf, std::size_t len);
+
+private:
+    int fd_m;
+    std::vector<char> buf_m;
+    std::size_t begin_m, end_m;                 // unread input in buf_m
+    bool eof_m;
+};
+
+// Input from a region of memory, such as a mapped file, which must
+// outlive the source. Nothing is copied but what R is handed.
+class MemoryInput : public ConsoleInput {
+public:
+    MemoryInput(const char* data, std::size_t size);
+    std::size_t readLine(char* buf, std::size_t len);
+
+private:
+    const char* pos_m;
+    const char* end_m;
+};
+
+// Input written by other threads into a fixed ring buffer: write()
+// waits while the buffer is full, and readLine(), on the R thread,
+// waits for a whole line (or a full buffer, or close()).
+class RingInput : public ConsoleInput {
+public:
+    explicit RingInput(std::size_t capacity = 1 << 20);
+
+    // Appends len bytes; returns false if the input was closed.
+    bool write(const char* data, std::size_t len);
+    void close();                               // end of input
+    std::size_t readLine(char* buf, std::size_t len);
+
+private:
+    std::size_t find(char c, std::size_t limit) const;
+    void copyOut(char* buf, std::size_t n);
+
+    std::vector<char> ring_m;
+    std::size_t head_m, size_m;                 // unread input
+    bool closed_m;
+    std::mutex mutex_m;
+    std::condition_variable readable_m, writable_m;
+};
+
+#endif
@@ -0,0 +1,77 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// ConsoleSink.cpp: buffered console output for RInside callbacks
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#include <ConsoleSink.h>
+
+#include <cstring>
+
+ConsoleSink::ConsoleSink(Writer writer, std::size_t capacity, Policy policy)
+    : writer_m(writer), capacity_m(0), policy_m(policy), type_m(0),
+      writing_m(false) {
+    setCapacity(capacity);
+}
+
+void ConsoleSink::setCapacity(std::size_t capacity) {
+    flush();
+    capacity_m = capacity > 0 ? capacity : 1;
+    std::vector<char>().swap(buf_m);
+    std::vector<char>().swap(spare_m);
+    buf_m.reserve(capacity_m);
+    spare_m.reserve(capacity_m);
+}
+
+// Passes on the first len bytes of the buffer. They are swapped into
+// spare_m first, so the rest of the buffer, and anything written after
+// the writer returns (or throws), start the next chunk.
+void ConsoleSink::emit(std::size_t len) {
+    if (len == 0)
+        return;
+    spare_m.clear();
+    spare_m.swap(buf_m);
+    buf_m.insert(buf_m.end(), spare_m.begin() + len, spare_m.end());
+    writing_m = true;
+    try {
+        writer_m(std::string_view(spare_m.data(), len), type_m);
+    } catch (...) {
+        writing_m = false;
+        throw;
+    }
+    writing_m = false;
+}
+
+void ConsoleSink::flush() {
+    if (!writing_m)
+        emit(buf_m.size());
+}
+
+void ConsoleSink::write(const char* buf, std::size_t len, int type) {
+    if (len == 0)
+        return;
+    // Output from the writer itself (say, through Rprintf) is not held
+    // back behind the chunk it is writing.
+    if (writing_m || len >= capacity_m) {
+        flush();
+        writer_m(std::string_view(buf, len), type);
+        return;
+    }
+    if (type != type_m) {
+        flush();
+        type_m = type;
+    }
+    if (buf_m.size() + len > capacity_m)
+        flush();
+    buf_m.insert(buf_m.end(), buf, buf + len);
+    if (buf_m.size() == capacity_m) {
+        flush();
+    } else if (policy_m == FLUSH_LINE && memchr(buf, '\n', len) != NULL) {
+        // Up to and including the last newline of this write.
+        std::size_t end = buf_m.size();
+        while (buf_m[end - 1] != '\n')
+            end--;
+        emit(end);
+    }
+}
@@ -0,0 +1,63 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// ConsoleSink.h: buffered console output for RInside callbacks
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#ifndef RINSIDE_CONSOLESINK_H
+#define RINSIDE_CONSOLESINK_H
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+// Collects the fragments R writes to the console (often a few bytes
+// each: a number, a separator, a newline) into a buffer, and hands them
+// to the writer as contiguous chunks, so printing a large object costs
+// a few calls instead of one per fragment.
+//
+// Buffered output goes to the writer when
+//   - the buffer is full (FLUSH_FULL, the default),
+//   - a write ends a line, up to the last newline (FLUSH_LINE),
+//   - flush() is called: R_FlushConsole, console input, the end of
+//     each evaluation by RInside,
+//   - the output type (0 regular, 1 warnings and errors) changes, so
+//     the two streams stay in order.
+// A write no smaller than the buffer is passed on as it is, without
+// copying. The chunks are only valid during the call to the writer.
+class ConsoleSink {
+public:
+    enum Policy { FLUSH_FULL = 0, FLUSH_LINE = 1 };
+
+    typedef std::function<void(std::string_view chunk, int type)> Writer;
+
+    explicit ConsoleSink(Writer writer, std::size_t capacity = 65536,
+                         Policy policy = FLUSH_FULL);
+
+    void write(const char* buf, std::size_t len, int type);
+    void flush();
+
+    void setCapacity(std::size_t capacity);
+    std::size_t capacity() const { return capacity_m; }
+    void setPolicy(Policy policy) { policy_m = policy; }
+    Policy policy() const { return policy_m; }
+    std::size_t pending() const { return buf_m.size(); }
+
+private:
+    ConsoleSink(const ConsoleSink&);
+    ConsoleSink& operator=(const ConsoleSink&);
+
+    void emit(std::size_t len);                 // pass on buf_m[0, len)
+
+    Writer writer_m;
+    std::vector<char> buf_m;                    // output not yet passed on
+    std::vector<char> spare_m;                  // the chunk being passed on
+    std::size_t capacity_m;
+    Policy policy_m;
+    int type_m;                                 // type of the output in buf_m
+    bool writing_m;                             // inside the writer
+};
+
+#endif
@@ -0,0 +1,231 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// ExternalVector.cpp: C++ buffers shared with R without copying
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#include <ExternalVector.h>
+
+#include <cstring>
+#include <utility>
+
+#include <R_ext/Rdynload.h>
+// R 3.5 used 'class' as a parameter name in Altrep.h.
+#if R_VERSION < R_Version(3, 6, 0)
+#define class klass
+extern "C" {
+#include <R_ext/Altrep.h>
+}
+#undef class
+#else
+#include <R_ext/Altrep.h>
+#endif
+
+// The ALTREP vectors: data1 is an external pointer to the buffer, whose
+// tag holds the length (as a double, for long vectors); data2 is
+// R_NilValue, or a copy of the elements in R memory, made when code
+// asked for a writable pointer or when the handle was released while R
+// still used the vector. Once there is a copy the buffer is not read.
+
+static R_altrep_class_t external_real;
+static R_altrep_class_t external_integer;
+
+static R_xlen_t extLength(SEXP x) {
+    return (R_xlen_t)REAL(R_ExternalPtrTag(R_altrep_data1(x)))[0];
+}
+
+static void* copyData(SEXP copy) {
+    return TYPEOF(copy) == REALSXP ? (void*)REAL(copy) : (void*)INTEGER(copy);
+}
+
+static std::size_t elementSize(SEXP x) {
+    return TYPEOF(x) == REALSXP ? sizeof(double) : sizeof(int);
+}
+
+// Copies the buffer into data2, unless that was done already.
+static void* detach(SEXP x) {
+    SEXP copy = R_altrep_data2(x);
+    if (copy == R_NilValue) {
+        R_xlen_t n = extLength(x);
+        copy = PROTECT(Rf_allocVector(TYPEOF(x), n));
+        memcpy(copyData(copy), R_ExternalPtrAddr(R_altrep_data1(x)), n*elementSize(x));
+        R_set_altrep_data2(x, copy);
+        UNPROTECT(1);
+    }
+    return copyData(copy);
+}
+
+// A vector whose handle was released without a copy (R did not hold it
+// elsewhere) may still be reached from C++ or a PROTECT stack; using it
+// is an error rather than a read of freed memory.
+static void* extData(SEXP x) {
+    SEXP copy = R_altrep_data2(x);
+    if (copy != R_NilValue)
+        return copyData(copy);
+    void* data = R_ExternalPtrAddr(R_altrep_data1(x));
+    if (data == NULL && extLength(x) > 0)
+        Rf_error("the buffer of this external vector has been released");
+    return data;
+}
+
+static R_xlen_t extLengthMethod(SEXP x) {
+    return extLength(x);
+}
+
+// Writable access (REAL(x), INTEGER(x), an Rcpp NumericVector) gets a
+// copy: compiled code may write through the pointer whatever R's
+// reference counts say, and the buffer belongs to C++. Read-only access
+// (REAL_RO, element and region methods) stays on the buffer.
+static void* extDataptr(SEXP x, Rboolean writeable) {
+    if (writeable && R_ExternalPtrAddr(R_altrep_data1(x)) != NULL)
+        return detach(x);
+    return extData(x);
+}
+
+// Never an error: NULL sends the caller to the element methods.
+static const void* extDataptrOrNull(SEXP x) {
+    SEXP copy = R_altrep_data2(x);
+    return copy != R_NilValue ? copyData(copy) : R_ExternalPtrAddr(R_altrep_data1(x));
+}
+
+static double extRealElt(SEXP x, R_xlen_t i) {
+    return static_cast<const double*>(extData(x))[i];
+}
+
+static int extIntegerElt(SEXP x, R_xlen_t i) {
+    return static_cast<const int*>(extData(x))[i];
+}
+
+static R_xlen_t extRealRegion(SEXP x, R_xlen_t i, R_xlen_t n, double* buf) {
+    R_xlen_t len = extLength(x);
+    R_xlen_t count = i + n > len ? len - i : n;
+    memcpy(buf, static_cast<const double*>(extData(x)) + i, count*sizeof(double));
+    return count;
+}
+
+static R_xlen_t extIntegerRegion(SEXP x, R_xlen_t i, R_xlen_t n, int* buf) {
+    R_xlen_t len = extLength(x);
+    R_xlen_t count = i + n > len ? len - i : n;
+    memcpy(buf, static_cast<const int*>(extData(x)) + i, count*sizeof(int));
+    return count;
+}
+
+static Rboolean extInspect(SEXP x, int pre, int deep, int pvec,
+                           void (*inspect_subtree)(SEXP, int, int, int)) {
+    Rprintf(" RInside external %s (len=%ld, %s)\n",
+            TYPEOF(x) == REALSXP ? "real" : "integer", (long)extLength(x),
+            R_altrep_data2(x) == R_NilValue ? "shared" : "copied");
+    return TRUE;
+}
+
+// No Serialized_state method: serialize() writes the elements, and
+// reading them back makes an ordinary vector.
+static void registerClasses() {
+    static bool registered = false;
+    if (registered)
+        return;
+    DllInfo* dll = R_getEmbeddingDllInfo();
+
+    external_real = R_make_altreal_class("external_real", "RInside", dll);
+    R_set_altrep_Length_method(external_real, extLengthMethod);
+    R_set_altrep_Inspect_method(external_real, extInspect);
+    R_set_altvec_Dataptr_method(external_real, extDataptr);
+    R_set_altvec_Dataptr_or_null_method(external_real, extDataptrOrNull);
+    R_set_altreal_Elt_method(external_real, extRealElt);
+    R_set_altreal_Get_region_method(external_real, extRealRegion);
+
+    external_integer = R_make_altinteger_class("external_integer", "RInside", dll);
+    R_set_altrep_Length_method(external_integer, extLengthMethod);
+    R_set_altrep_Inspect_method(external_integer, extInspect);
+    R_set_altvec_Dataptr_method(external_integer, extDataptr);
+    R_set_altvec_Dataptr_or_null_method(external_integer, extDataptrOrNull);
+    R_set_altinteger_Elt_method(external_integer, extIntegerElt);
+    R_set_altinteger_Get_region_method(external_integer, extIntegerRegion);
+
+    registered = true;
+}
+
+ExternalVector::ExternalVector(const std::string& name, double* data,
+                               std::size_t length, std::function<void()> onRelease)
+    : name_m(name), x_m(R_NilValue), holder_m(R_NilValue), on_release_m(onRelease) {
+    bind(REALSXP, data, length);
+}
+
+ExternalVector::ExternalVector(const std::string& name, int* data,
+                               std::size_t length, std::function<void()> onRelease)
+    : name_m(name), x_m(R_NilValue), holder_m(R_NilValue), on_release_m(onRelease) {
+    bind(INTSXP, data, length);
+}
+
+void ExternalVector::bind(SEXPTYPE type, void* data, std::size_t length) {
+    registerClasses();
+    SEXP len = PROTECT(Rf_ScalarReal((double)length));
+    SEXP ptr = PROTECT(R_MakeExternalPtr(data, len, R_NilValue));
+    SEXP x = PROTECT(R_new_altrep(type == REALSXP ? external_real : external_integer,
+                                  ptr, R_NilValue));
+    // The handle holds the vector through a list of its own, so that
+    // dropping it in release() is seen by R's reference count.
+    holder_m = Rf_allocVector(VECSXP, 1);
+    R_PreserveObject(holder_m);
+    SET_VECTOR_ELT(holder_m, 0, x);
+    x_m = x;
+    Rf_defineVar(Rf_install(name_m.c_str()), x, R_GlobalEnv);
+    UNPROTECT(3);
+}
+
+ExternalVector::ExternalVector(ExternalVector&& v)
+    : name_m(std::move(v.name_m)), x_m(v.x_m), holder_m(v.holder_m),
+      on_release_m(std::move(v.on_release_m)) {
+    v.x_m = R_NilValue;
+    v.holder_m = R_NilValue;
+}
+
+ExternalVector& ExternalVector::operator=(ExternalVector&& v) {
+    if (this != &v) {
+        release();
+        name_m = std::move(v.name_m);
+        x_m = v.x_m;
+        holder_m = v.holder_m;
+        on_release_m = std::move(v.on_release_m);
+        v.x_m = R_NilValue;
+        v.holder_m = R_NilValue;
+    }
+    return *this;
+}
+
+ExternalVector::~ExternalVector() {
+    release();
+}
+
+bool ExternalVector::release() {
+    if (x_m == R_NilValue)
+        return false;
+    SEXP x = PROTECT(x_m);
+    SEXP sym = Rf_install(name_m.c_str());
+    if (Rf_findVarInFrame(R_GlobalEnv, sym) == x) {
+#if R_VERSION >= R_Version(4, 2, 0)
+        R_removeVarFromFrame(sym, R_GlobalEnv);
+#else
+        Rcpp::Environment::global_env().remove(name_m);
+#endif
+    }
+    SET_VECTOR_ELT(holder_m, 0, R_NilValue);
+    R_ReleaseObject(holder_m);
+    holder_m = R_NilValue;
+    x_m = R_NilValue;
+
+    bool copied = false;
+    if (MAYBE_REFERENCED(x) && R_altrep_data2(x) == R_NilValue) {
+        detach(x);
+        copied = true;
+    }
+    R_ClearExternalPtr(R_altrep_data1(x));
+    UNPROTECT(1);
+
+    std::function<void()> onRelease;
+    onRelease.swap(on_release_m);
+    if (onRelease)
+        onRelease();
+    return copied;
+}
@@ -0,0 +1,133 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// ExternalVector.h: C++ buffers shared with R without copying
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#ifndef RINSIDE_EXTERNALVECTOR_H
+#define RINSIDE_EXTERNALVECTOR_H
+
+#include <RInsideCommon.h>
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#if defined(__cpp_lib_span) || (__cplusplus >= 202002L && __has_include(<span>))
+#include <span>
+#define RINSIDE_SPAN
+#endif
+
+// Exposes memory owned by C++ (a std::vector, a std::span, a mapped
+// file) to R as a numeric or integer vector bound to a name, without
+// copying it into the R heap. The vector is an ALTREP object that
+// reads the buffer itself (REAL_RO, element and region access);
+// R code that assigns into it works on a copy, and compiled code asking
+// for a writable pointer (REAL, an Rcpp NumericVector) gets the
+// elements copied into R memory first, so the buffer is never written.
+//
+// The handle ties the buffer to R: the buffer must stay valid until the
+// handle is released (or destroyed), which unbinds the name. Should R
+// still hold the vector elsewhere by then (y <- x, a list element), its
+// elements are copied into R memory first, so nothing in R is left
+// pointing at the buffer; R's reference counts can overestimate, which
+// only costs that copy. onRelease, if given, runs once R no longer uses
+// the buffer (to unmap a file, say). A vector released without a copy
+// and still reached from C++ (through sexp()) raises an R error when
+// its elements are read.
+//
+//     std::vector<double> big = load();
+//     ExternalVector x("x", big.data(), big.size());
+//     R.parseEvalQ("s <- summary(x)");
+//     ...
+//     x.release();                // or let x go out of scope
+//
+// Handles are created and released on the R thread, outside of R
+// evaluation (not from code called by R).
+class ExternalVector {
+public:
+    ExternalVector() : x_m(R_NilValue), holder_m(R_NilValue) {}
+    ExternalVector(const std::string& name, double* data, std::size_t length,
+                   std::function<void()> onRelease = std::function<void()>());
+    ExternalVector(const std::string& name, int* data, std::size_t length,
+                   std::function<void()> onRelease = std::function<void()>());
+#ifdef RINSIDE_SPAN
+    template <std::size_t E>
+    ExternalVector(const std::string& name, std::span<double, E> data,
+                   std::function<void()> onRelease = std::function<void()>())
+        : ExternalVector(name, data.data(), data.size(), onRelease) {}
+    template <std::size_t E>
+    ExternalVector(const std::string& name, std::span<int, E> data,
+                   std::function<void()> onRelease = std::function<void()>())
+        : ExternalVector(name, data.data(), data.size(), onRelease) {}
+#endif
+    ExternalVector(ExternalVector&& v);
+    ExternalVector& operator=(ExternalVector&& v);
+    ~ExternalVector();
+
+    // Unbinds the name (if it is still bound to this vector), copies the
+    // elements into R if R may still use them, and runs onRelease.
+    // Returns true if the elements were copied.
+    bool release();
+
+    SEXP sexp() const { return x_m; }
+    const std::string& name() const { return name_m; }
+
+private:
+    ExternalVector(const ExternalVector&);
+    ExternalVector& operator=(const ExternalVector&);
+
+    void bind(SEXPTYPE type, void* data, std::size_t length);
+
+    std::string name_m;
+    SEXP x_m;
+    SEXP holder_m;                              // preserved list(x_m)
+    std::function<void()> on_release_m;
+};
+
+// Read-only view of the elements of an R vector of type T (double for
+// numeric, int for integer), without copying them; the vector is kept
+// alive as long as the view. Throws if the vector has another type
+// rather than coercing (which would copy).
+//
+//     VectorView<double> coef(R.parseEval("coef(fit)"));
+//     for (double c : coef) ...
+template <typename T>
+class VectorView {
+public:
+    explicit VectorView(SEXP x);
+
+    const T* data() const { return data_m; }
+    std::size_t size() const { return size_m; }
+    const T& operator[](std::size_t i) const { return data_m[i]; }
+    const T* begin() const { return data_m; }
+    const T* end() const { return data_m + size_m; }
+#ifdef RINSIDE_SPAN
+    std::span<const T> span() const { return std::span<const T>(data_m, size_m); }
+#endif
+
+private:
+    Rcpp::RObject x_m;
+    const T* data_m;
+    std::size_t size_m;
+};
+
+template <>
+inline VectorView<double>::VectorView(SEXP x) : x_m(x) {
+    if (TYPEOF(x) != REALSXP)
+        throw std::invalid_argument("VectorView<double>: not a numeric vector");
+    data_m = REAL_RO(x);
+    size_m = XLENGTH(x);
+}
+
+template <>
+inline VectorView<int>::VectorView(SEXP x) : x_m(x) {
+    if (TYPEOF(x) != INTSXP)
+        throw std::invalid_argument("VectorView<int>: not an integer vector");
+    data_m = INTEGER_RO(x);
+    size_m = XLENGTH(x);
+}
+
+#endif
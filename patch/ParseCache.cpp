@@ -0,0 +1,68 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// ParseCache.cpp: cache of parsed R code for RInside::parseEval
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#include <ParseCache.h>
+
+ParseCache::ParseCache(std::size_t capacity)
+    : capacity_m(capacity), hits_m(0), misses_m(0), insertions_m(0),
+      evictions_m(0) {
+}
+
+SEXP ParseCache::lookup(const std::string& code) {
+    if (capacity_m == 0)
+        return NULL;
+    std::unordered_map<std::string, EntryList::iterator>::iterator it = index_m.find(code);
+    if (it == index_m.end()) {
+        ++misses_m;
+        return NULL;
+    }
+    entries_m.splice(entries_m.begin(), entries_m, it->second);
+    ++hits_m;
+    return it->second->second;
+}
+
+void ParseCache::insert(const std::string& code, SEXP expr) {
+    if (capacity_m == 0 || index_m.count(code))
+        return;
+    evict(capacity_m - 1);
+    R_PreserveObject(expr);
+    entries_m.push_front(std::make_pair(code, expr));
+    index_m[code] = entries_m.begin();
+    ++insertions_m;
+}
+
+void ParseCache::setCapacity(std::size_t capacity) {
+    capacity_m = capacity;
+    evict(capacity);
+}
+
+void ParseCache::clear() {
+    for (EntryList::iterator it = entries_m.begin(); it != entries_m.end(); ++it)
+        R_ReleaseObject(it->second);
+    entries_m.clear();
+    index_m.clear();
+}
+
+// Releases least recently used entries until at most keep remain.
+void ParseCache::evict(std::size_t keep) {
+    while (entries_m.size() > keep) {
+        R_ReleaseObject(entries_m.back().second);
+        index_m.erase(entries_m.back().first);
+        entries_m.pop_back();
+        ++evictions_m;
+    }
+}
+
+ParseCache::Stats ParseCache::stats() const {
+    Stats s = {hits_m, misses_m, insertions_m, evictions_m,
+               entries_m.size(), capacity_m};
+    return s;
+}
+
+void ParseCache::resetStats() {
+    hits_m = misses_m = insertions_m = evictions_m = 0;
+}
@@ -0,0 +1,67 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// ParseCache.h: cache of parsed R code for RInside::parseEval
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#ifndef RINSIDE_PARSECACHE_H
+#define RINSIDE_PARSECACHE_H
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <Rinternals.h>
+
+// Least-recently-used map from R source text to the EXPRSXP that
+// R_ParseVector() produced for it. Cached expressions are kept alive
+// with R_PreserveObject() and released when evicted, so a hit can be
+// evaluated directly without parsing again. Only code that parsed
+// completely (PARSE_OK) is stored. All members must be called on the
+// R thread.
+class ParseCache {
+public:
+    struct Stats {
+        unsigned long hits, misses, insertions, evictions;
+        std::size_t entries, capacity;
+    };
+
+    explicit ParseCache(std::size_t capacity = 256);
+
+    // Does not release the entries: R has normally been shut down by
+    // the time an RInside member is destroyed, so RInside calls clear()
+    // itself first.
+    ~ParseCache() {}
+
+    // Returns the cached EXPRSXP for code, or NULL. The result stays
+    // valid until the next insert(), setCapacity() or clear().
+    SEXP lookup(const std::string& code);
+
+    // Caches expr (an EXPRSXP) for code, evicting the least recently
+    // used entry when the cache is full.
+    void insert(const std::string& code, SEXP expr);
+
+    // At most capacity entries are kept; 0 disables the cache.
+    void setCapacity(std::size_t capacity);
+    std::size_t capacity() const { return capacity_m; }
+
+    void clear();
+
+    Stats stats() const;
+    void resetStats();
+
+private:
+    typedef std::list<std::pair<std::string, SEXP> > EntryList;
+
+    void evict(std::size_t keep);
+
+    std::size_t capacity_m;
+    EntryList entries_m;        // most recently used first
+    std::unordered_map<std::string, EntryList::iterator> index_m;
+    unsigned long hits_m, misses_m, insertions_m, evictions_m;
+};
+
+#endif
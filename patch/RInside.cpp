@@ -22,6 +22,8 @@
 
 #include <RInside.h>
 #include <Callbacks.h>
+#include <chrono>
+#include <cstring>
 #ifndef _WIN32
   #define R_INTERFACE_PTRS
   #include <Rinterface.h>
@@ -95,6 +97,7 @@ int gettimeofday(struct timeval* tp, struct timezone* tzp) {
 #endif // end _MSC_VER
 
 RInside::~RInside() {           // now empty as MemBuf is internal
+    parse_cache_m.clear();      // releases preserved objects, so before R goes
     R_dot_Last();
     R_RunExitFinalizers();
     R_CleanTempDir();
@@ -115,12 +118,19 @@ RInside::RInside(): global_env_m(NULL)
     initialize(0, 0, false, false, false);
 }
 
+// Console input installed by RInside::setConsoleInput(), if any.
+static ConsoleInput* console_input = 0;
+
 #ifdef _WIN32
 #if R_VERSION >= R_Version(4,2,0)
 static int myReadConsole(const char *prompt, unsigned char *buf, int len, int addtohistory) {
 #else
 static int myReadConsole(const char *prompt, char *buf, int len, int addtohistory) {
 #endif
+    if (console_input) {
+        RInside::instance().flushOutput();
+        return console_input->readLine((char *)buf, len) > 0 ? 1 : 0;
+    }
     fputs(prompt, stdout);
     fflush(stdout);
     if (fgets((char *)buf, len, stdin))
@@ -162,6 +172,14 @@ RInside::RInside(const int argc, const char* const argv[], const bool loadRcpp,
     initialize(argc, argv, loadRcpp, verbose, interactive);
 }
 
+// Appends the time since the previous mark to the startup profile.
+void RInside::markStartup(const char* phase) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    startup_profile_m.push_back(std::make_pair(std::string(phase),
+        std::chrono::duration<double, std::milli>(now - startup_mark_m).count()));
+    startup_mark_m = now;
+}
+
 // TODO: use a vector<string> would make all this a bit more readable
 void RInside::initialize(const int argc, const char* const argv[], const bool loadRcpp,
                          const bool verbose, const bool interactive) {
@@ -174,6 +192,8 @@ void RInside::initialize(const int argc, const char* const argv[], const bool lo
 
     verbose_m = verbose;          	// Default is false
     interactive_m = interactive;
+    startup_profile_m.clear();
+    startup_mark_m = std::chrono::steady_clock::now();
 
     // generated from Makevars{.win}
     #include "RInsideEnvVars.h"
@@ -205,16 +225,25 @@ void RInside::initialize(const int argc, const char* const argv[], const bool lo
     #endif
 
     init_tempdir();
+    markStartup("environment");
 
     const char *R_argv[] = {(char*)programName, "--gui=none", "--no-save",
                             "--silent", "--vanilla", "--slave", "--no-readline"};
     int R_argc = sizeof(R_argv) / sizeof(R_argv[0]);
     if (interactive_m) R_argc--; //Deleting the --no-readline option in interactive mode
-    Rf_initEmbeddedR(R_argc, (char**)R_argv);
-
     #ifndef _WIN32
-    R_CStackLimit = -1;      		// Don't do any stack checking, see R Exts, '8.1.5 Threading issues'
+    // Rf_initEmbeddedR in steps: R takes the stack start from the thread
+    // calling Rf_initialize_R, and setup_Rmainloop already checks the
+    // stack, which fails when RInside runs on a thread of its own (see
+    // RInsideExecutor). So stack checking is turned off in between.
+    Rf_initialize_R(R_argc, (char**)R_argv);
+    R_CStackLimit = (uintptr_t)-1;      // Don't do any stack checking, see R Exts, '8.1.5 Threading issues'
+    R_Interactive = TRUE;               // as Rf_initEmbeddedR; R_SetParams below decides
+    setup_Rmainloop();
+    #else
+    Rf_initEmbeddedR(R_argc, (char**)R_argv);
     #endif
+    markStartup("Rf_initEmbeddedR");
 
     R_ReplDLLinit();                    // this is to populate the repl console buffers
 
@@ -263,6 +292,7 @@ void RInside::initialize(const int argc, const char* const argv[], const bool lo
     
 #endif // _WIN32
     R_SetParams(&Rst);
+    markStartup("console and parameters");
 
     if (true || loadRcpp) {             // we always need Rcpp, so load it anyway
         // Use R_LIBS to locate Rcpp.
@@ -292,9 +322,12 @@ void RInside::initialize(const int argc, const char* const argv[], const bool lo
         UNPROTECT(2);
     }
 
+    markStartup("require(Rcpp)");
+
     global_env_m = new Rcpp::Environment();         // member variable for access to R's global environment
 
     autoloads();                        // loads all default packages, using code autogenerate from Makevars{,.win}
+    markStartup("autoloads");
 
     if ((argc - optind) > 1){           // for argv vector in Global Env */
         Rcpp::CharacterVector s_argv( argv+(1+optind), argv+argc );
@@ -304,6 +337,19 @@ void RInside::initialize(const int argc, const char* const argv[], const bool lo
     }
 
     init_rand();                        // for tempfile() to work correctly */
+    markStartup("argv and seed");
+
+    // RINSIDE_STARTUP_PROFILE=1 in the environment prints the times.
+    const char* profile = getenv("RINSIDE_STARTUP_PROFILE");
+    if (verbose_m || (profile != NULL && *profile != '\0' && strcmp(profile, "0") != 0)) {
+        double total = 0;
+        for (size_t i = 0; i < startup_profile_m.size(); i++) {
+            Rprintf("%s: startup %-24s %8.2f ms\n", programName,
+                    startup_profile_m[i].first.c_str(), startup_profile_m[i].second);
+            total += startup_profile_m[i].second;
+        }
+        Rprintf("%s: startup %-24s %8.2f ms\n", programName, "total", total);
+    }
 }
 
 void RInside::init_tempdir(void) {
@@ -337,6 +383,18 @@ void RInside::init_rand(void) { 		// code borrows from R's TimeToSeed() in datet
     srand(seed);
 }
 
+// For a forked copy of the interpreter: seeds srand() (used by R for
+// tempfile names) again from the new pid and the time, and restarts R's
+// generator from it, so processes forked from one parent do not share
+// random streams or temporary file names.
+void RInside::reseed(void) {
+    init_rand();
+    if (global_env_m->exists(".Random.seed"))
+        global_env_m->remove(".Random.seed");
+    Rcpp::Function setSeed("set.seed");
+    setSeed(rand());
+}
+
 void RInside::autoloads() {
 
     #include "RInsideAutoloads.h"
@@ -365,116 +423,189 @@ void RInside::autoloads() {
     // the list of packages, which by my code analysis is useless and only
     // for informational purposes.
     //
+    // Each name gets the binding delayedAssign() would give it,
     //
-
-    // we build the call :
+    //  NAME <- promise of autoloader(name = NAME, package = PACKAGE)
+    //          in .GlobalEnv, evaluated in .AutoloadEnv
     //
-    //  delayedAssign( NAME,
-    //          autoloader( name = NAME, package = PACKAGE),
-    //          .GlobalEnv,
-    //          .AutoloadEnv )
-    //
-    //  where :
-    //  - PACKAGE is updated in a loop
-    //  - NAME is updated in a loop
-    //
-    //
-
-    int i,j, idx=0, nobj ;
-    Rcpp::Language delayed_assign_call(Rcpp::Function("delayedAssign"),
-                                       R_NilValue,     // arg1: assigned in loop
-                                       R_NilValue,     // arg2: assigned in loop
-                                       *global_env_m,
-                                       global_env_m->find(".AutoloadEnv")
-                                       );
-    Rcpp::Language::Proxy delayed_assign_name  = delayed_assign_call[1];
-
-    Rcpp::Language autoloader_call(Rcpp::Function("autoloader"),
-                                   Rcpp::Named( "name", R_NilValue) ,  // arg1 : assigned in loop
-                                   Rcpp::Named( "package", R_NilValue) // arg2 : assigned in loop
-                                   );
-    Rcpp::Language::Proxy autoloader_name = autoloader_call[1];
-    Rcpp::Language::Proxy autoloader_pack = autoloader_call[2];
-    delayed_assign_call[2] = autoloader_call;
-
-    try {
-        for( i=0; i<packc; i++){
-
-            // set the 'package' argument of the autoloader call */
-            autoloader_pack = pack[i] ;
-
-            nobj = packobjc[i] ;
-            for (j = 0; j < nobj ; j++){
+    // but built directly in C: evaluating a delayedAssign() call per
+    // object (through Rcpp's protected evaluation) made this the
+    // largest part of startup, for thousands of objects. Define
+    // RINSIDE_DELAYED_ASSIGN to go through delayedAssign() instead.
+
+    SEXP autoloadEnv = Rf_findVar(Rf_install(".AutoloadEnv"), R_GlobalEnv);
+    if (TYPEOF(autoloadEnv) != ENVSXP) {
+        throw std::runtime_error("Error in autoloads: .AutoloadEnv not found");
+    }
+    PROTECT(autoloadEnv);
+    SEXP autoloaderSym = Rf_install("autoloader");
+    SEXP nameSym = Rf_install("name");
+    SEXP packageSym = Rf_install("package");
+#ifdef RINSIDE_DELAYED_ASSIGN
+    SEXP delayedAssignSym = Rf_install("delayedAssign");
+#endif
 
-                // set the 'name' argument of the autoloader call */
-                autoloader_name = packobj[idx+j] ;
+    int i, j, idx = 0;
+    for (i = 0; i < packc; i++) {
+        SEXP package = PROTECT(Rf_mkString(pack[i]));
+        for (j = 0; j < packobjc[i]; j++) {
+            const char* name = packobj[idx + j];
+            SEXP call = PROTECT(Rf_lang3(autoloaderSym, Rf_mkString(name), package));
+            SET_TAG(CDR(call), nameSym);
+            SET_TAG(CDDR(call), packageSym);
+#ifndef RINSIDE_DELAYED_ASSIGN
+            // Symbol first: Rf_install may allocate, and the order of
+            // evaluation of arguments is unspecified.
+            SEXP sym = Rf_install(name);
+            SEXP promise = PROTECT(Rf_mkPROMISE(call, autoloadEnv));
+            Rf_defineVar(sym, promise, R_GlobalEnv);
+            UNPROTECT(1);
+#else
+            // For R builds that hide Rf_mkPROMISE: one call of
+            // delayedAssign(), which quotes its value argument.
+            SEXP assign = PROTECT(Rf_lang5(delayedAssignSym, Rf_mkString(name),
+                                           call, R_GlobalEnv, autoloadEnv));
+            int errorOccurred;
+            R_tryEval(assign, R_BaseEnv, &errorOccurred);
+            UNPROTECT(1);
+            if (errorOccurred) {
+                UNPROTECT(3);
+                throw std::runtime_error(std::string("Error calling delayedAssign for ") + name);
+            }
+#endif
+            UNPROTECT(1);
+        }
+        idx += packobjc[i];
+        UNPROTECT(1);
+    }
+    UNPROTECT(1);
+}
 
-                // Set the 'name' argument of the delayedAssign call */
-                delayed_assign_name = packobj[idx+j] ;
+// Evaluates each expression of an EXPRSXP in env, leaving the last
+// value in ans; returns 1 if an evaluation failed.
+int RInside::evalExprs(SEXP cmdexpr, SEXP env, SEXP & ans) {
+    int i, errorOccurred;
 
-                // evaluate the call */
-                delayed_assign_call.eval() ;
+    // cmdexpr may come from the parse cache, and a nested parseEval()
+    // can evict it while it is being evaluated.
+    PROTECT(cmdexpr);
+    // Loop is needed here as EXPSEXP might be of length > 1
+    for(i = 0; i < Rf_length(cmdexpr); i++){
+        ans = R_tryEval(VECTOR_ELT(cmdexpr, i), env, &errorOccurred);
+        if (errorOccurred) {
+            if (verbose_m) Rf_warning("%s: Error in evaluating R code\n", programName);
+            UNPROTECT(1);
+            flushOutput();
+            return 1;
+        }
+        if (verbose_m) {
+            Rf_PrintValue(ans);
+        }
+    }
+    UNPROTECT(1);
+    flushOutput();
+    return 0;
+}
 
-            }
-            idx += packobjc[i] ;
+// Passes on console output still held in the callbacks' buffer.
+void RInside::flushOutput() {
+#ifdef RINSIDE_CALLBACKS
+    if (callbacks) {
+        try {
+            callbacks->FlushOutput_();
+        } catch (std::exception& ex) {
+            // A failing writer must not lose the result of the evaluation.
         }
-    } catch( std::exception& ex){
-        throw std::runtime_error(std::string("Error calling delayedAssign: ") + std::string(ex.what()));
     }
+#endif
+}
+
+// Drops input accumulated by parseEval() while waiting for complete code.
+void RInside::rewindInput() {
+    mb_m.rewind();
+    scan_m.reset();
+}
+
+// Appends a line of incomplete code to the buffer. The buffer ends each
+// line with a newline, and so must the scanner (a comment ends there).
+void RInside::holdBack(const std::string & line) {
+    mb_m.add(line);
+    scan_m.scan(line.data(), line.size());
+    scan_m.scan("\n", 1);
 }
 
 // this is a non-throwing version returning an error code
 int RInside::parseEval(const std::string & line, SEXP & ans) {
     ParseStatus status;
     SEXP cmdSexp, cmdexpr = R_NilValue;
-    int i, errorOccurred;
+    int rc;
+
+    ans = R_NilValue;
 
-    mb_m.add((char*)line.c_str());
+    // Unless an incomplete line is waiting in the buffer, code that has
+    // been parsed before is evaluated straight from the parse cache.
+    bool pending = mb_m.getBufPtr()[0] != '\0';
+    if (!pending && (cmdexpr = parse_cache_m.lookup(line)) != NULL)
+        return evalExprs(cmdexpr, *global_env_m, ans);
 
+    // A line that starts new code goes to the parser directly, which
+    // reports errors in it right away. Continuation lines are scanned
+    // once as they arrive, and the accumulated buffer is only parsed
+    // again when the input so far could be complete, so a long
+    // multi-line block is not parsed again for every line it spans.
     PROTECT(cmdSexp = Rf_allocVector(STRSXP, 1));
-    SET_STRING_ELT(cmdSexp, 0, Rf_mkChar(mb_m.getBufPtr()));
+    if (pending) {
+        holdBack(line);
+        if (!scan_m.complete()) {
+            UNPROTECT(1);
+            return 0;           // need to read another line
+        }
+        SET_STRING_ELT(cmdSexp, 0, Rf_mkChar(mb_m.getBufPtr()));
+    } else {
+        // Rf_mkCharLen raises an R error on an embedded nul, and there
+        // is no R context here to catch it.
+        if (memchr(line.data(), '\0', line.size()) != NULL) {
+            if (verbose_m) Rf_warning("Parse Error: embedded nul in \"%s\"\n", line.c_str());
+            UNPROTECT(1);
+            return 1;
+        }
+        SET_STRING_ELT(cmdSexp, 0, Rf_mkCharLen(line.data(), (int)line.size()));
+    }
 
     cmdexpr = PROTECT(R_ParseVector(cmdSexp, -1, &status, R_NilValue));
 
     switch (status){
     case PARSE_OK:
-        // Loop is needed here as EXPSEXP might be of length > 1
-        for(i = 0; i < Rf_length(cmdexpr); i++){
-            ans = R_tryEval(VECTOR_ELT(cmdexpr, i), *global_env_m, &errorOccurred);
-            if (errorOccurred) {
-                if (verbose_m) Rf_warning("%s: Error in evaluating R code (%d)\n", programName, status);
-                UNPROTECT(2);
-                mb_m.rewind();
-                return 1;
-            }
-            if (verbose_m) {
-                Rf_PrintValue(ans);
-            }
-        }
-        mb_m.rewind();
+        if (!pending) parse_cache_m.insert(line, cmdexpr);
+        rc = evalExprs(cmdexpr, *global_env_m, ans);
+        UNPROTECT(2);
+        rewindInput();
+        return rc;
         break;
     case PARSE_INCOMPLETE:
         // need to read another line
+        if (!pending) holdBack(line);
         break;
     case PARSE_NULL:
         if (verbose_m) Rf_warning("%s: ParseStatus is null (%d)\n", programName, status);
         UNPROTECT(2);
-        mb_m.rewind();
+        rewindInput();
         return 1;
         break;
     case PARSE_ERROR:
         if (verbose_m) Rf_warning("Parse Error: \"%s\"\n", line.c_str());
         UNPROTECT(2);
-        mb_m.rewind();
+        rewindInput();
         return 1;
         break;
     case PARSE_EOF:
         if (verbose_m) Rf_warning("%s: ParseStatus is eof (%d)\n", programName, status);
+        if (!pending) holdBack(line);
         break;
     default:
         if (verbose_m) Rf_warning("%s: ParseStatus is not documented %d\n", programName, status);
         UNPROTECT(2);
-        mb_m.rewind();
+        rewindInput();
         return 1;
         break;
     }
@@ -482,6 +613,51 @@ int RInside::parseEval(const std::string & line, SEXP & ans) {
     return 0;
 }
 
+RInside::BatchResult RInside::parseEvalBatch(const std::vector<std::string> & code) {
+    BatchResult res;
+    ParseStatus status;
+    SEXP values, cmdSexp, cmdexpr, ans;
+    PROTECT_INDEX ipx;
+    R_xlen_t n = code.size();
+
+    // One protected scope for the whole batch: the source vector and
+    // the slot holding the parsed code are reused for every item, and
+    // the source goes straight from the std::string into a CHARSXP.
+    res.status.resize(n, BATCH_OK);
+    PROTECT(values = Rf_allocVector(VECSXP, n));
+    PROTECT(cmdSexp = Rf_allocVector(STRSXP, 1));
+    PROTECT_WITH_INDEX(cmdexpr = R_NilValue, &ipx);
+    for (R_xlen_t i = 0; i < n; i++) {
+        const std::string &line = code[i];
+        cmdexpr = parse_cache_m.lookup(line);
+        if (cmdexpr == NULL) {
+            // Rf_mkCharLen would raise an R error on an embedded nul.
+            if (memchr(line.data(), '\0', line.size()) != NULL) {
+                res.status[i] = BATCH_PARSE_ERROR;
+                continue;
+            }
+            SET_STRING_ELT(cmdSexp, 0, Rf_mkCharLen(line.data(), (int)line.size()));
+            REPROTECT(cmdexpr = R_ParseVector(cmdSexp, -1, &status, R_NilValue), ipx);
+            if (status != PARSE_OK) {
+                if (verbose_m) Rf_warning("Parse Error: \"%s\"\n", line.c_str());
+                res.status[i] = BATCH_PARSE_ERROR;
+                continue;
+            }
+            parse_cache_m.insert(line, cmdexpr);
+        } else {
+            REPROTECT(cmdexpr, ipx);
+        }
+        ans = R_NilValue;
+        if (evalExprs(cmdexpr, *global_env_m, ans) != 0)
+            res.status[i] = BATCH_EVAL_ERROR;
+        else
+            SET_VECTOR_ELT(values, i, ans);
+    }
+    res.values = values;
+    UNPROTECT(3);
+    return res;
+}
+
 void RInside::parseEvalQ(const std::string & line) {
     SEXP ans;
     int rc = parseEval(line, ans);
@@ -510,6 +686,45 @@ RInside::Proxy RInside::parseEvalNT(const std::string & line) {
     return Proxy( ans );
 }
 
+RInside::Statement RInside::prepare(const std::string & code) {
+    Rcpp::RObject expr(R_NilValue);
+    SEXP cmdexpr = parse_cache_m.lookup(code);
+    if (cmdexpr != NULL) {
+        expr = cmdexpr;
+    } else {
+        ParseStatus status;
+        SEXP cmdSexp;
+        PROTECT(cmdSexp = Rf_allocVector(STRSXP, 1));
+        SET_STRING_ELT(cmdSexp, 0, Rf_mkChar(code.c_str()));
+        cmdexpr = PROTECT(R_ParseVector(cmdSexp, -1, &status, R_NilValue));
+        if (status != PARSE_OK) {
+            UNPROTECT(2);
+            throw std::runtime_error(std::string("Error parsing: ") + code);
+        }
+        parse_cache_m.insert(code, cmdexpr);
+        expr = cmdexpr;
+        UNPROTECT(2);
+    }
+    return Statement(this, expr, global_env_m->new_child(true));
+}
+
+RInside::Statement::Statement(RInside* owner, SEXP expr, SEXP env)
+    : owner_m(owner), expr_m(expr), env_m(env) {
+}
+
+int RInside::Statement::execute(SEXP & ans) {
+    return owner_m->evalExprs(expr_m, env_m, ans);
+}
+
+RInside::Proxy RInside::Statement::execute() {
+    SEXP ans;
+    int rc = execute(ans);
+    if (rc != 0) {
+        throw std::runtime_error(std::string("Error evaluating prepared statement"));
+    }
+    return Proxy( ans );
+}
+
 Rcpp::Environment::Binding RInside::operator[]( const std::string& name ){
     return (*global_env_m)[name];
 }
@@ -526,6 +741,22 @@ extern "C" {
      void run_Rmainloop(void);
 }
  
+#ifndef _WIN32
+static int inputReadConsole(const char *prompt, unsigned char *buf, int len, int addtohistory) {
+    RInside::instance().flushOutput();  // the prompt and output so far
+    return console_input->readLine((char *)buf, len) > 0 ? 1 : 0;
+}
+#endif
+
+void RInside::setConsoleInput(ConsoleInput* input) {
+#ifndef _WIN32
+    // R's own reader comes back when the input is removed.
+    static int (*default_read)(const char *, unsigned char *, int, int) = ptr_R_ReadConsole;
+    ptr_R_ReadConsole = input ? inputReadConsole : default_read;
+#endif
+    console_input = input;
+}
+
 void RInside::repl() {
     run_Rmainloop();
 
@@ -533,6 +764,8 @@ void RInside::repl() {
     // For example, terminates after plot(0,0)
     // R_ReplDLLinit();
     // while (R_ReplDLLdo1() > 0) {}
+    // (An R error inside R_ReplDLLdo1 jumps back to R_ReplDLLinit;
+    // RInsideRepl.h runs each step under R_ToplevelExec instead.)
 }
 
 /* callbacks */
@@ -546,15 +779,21 @@ void Callbacks::Busy_( int which ){
 
 int Callbacks::ReadConsole_( const char* prompt, unsigned char* buf, int len, int addtohistory ){
     try {
-        std::string res( ReadConsole( prompt, static_cast<bool>(addtohistory) ) ) ;
-
-        /* At some point we need to figure out what to do if the result is
-         * longer than "len"... For now, just truncate. */
+        FlushOutput_() ;                // output so far, before the prompt
+        if( input_m ){
+            return input_m->readLine( (char*)buf, len ) > 0 ? 1 : 0 ;
+        }
 
-        int l = res.size() ;
-        int last = (l>len-1)?len-1:l ;
-        strncpy( (char*)buf, res.c_str(), last ) ;
+        /* A result longer than "len" is handed out over the following
+         * calls, before ReadConsole is asked for more. */
+        if( input_pos_m >= input_buf_m.size() ){
+            input_buf_m = ReadConsole( prompt, static_cast<bool>(addtohistory) ) ;
+            input_pos_m = 0 ;
+        }
+        size_t last = std::min( input_buf_m.size() - input_pos_m, (size_t)len - 1 ) ;
+        memcpy( buf, input_buf_m.data() + input_pos_m, last ) ;
         buf[last] = 0 ;
+        input_pos_m += last ;
         return 1 ;
     } catch( const std::exception& ex){
         return -1 ;
@@ -563,12 +802,35 @@ int Callbacks::ReadConsole_( const char* prompt, unsigned char* buf, int len, in
 
 
 void Callbacks::WriteConsole_( const char* buf, int len, int oType ){
-    if( len ){
+    if( !len ) return ;
+    if( has_WriteConsoleChunk() ){
+        if( !sink_m ){
+            sink_m = new ConsoleSink(
+                [this]( std::string_view chunk, int type ){ WriteConsoleChunk( chunk, type ) ; },
+                consoleBufferSize(), consoleFlushPolicy() ) ;
+        }
+        sink_m->write( buf, len, oType ) ;
+    } else {
         buffer.assign( buf, len ) ;
         WriteConsole( buffer, oType) ;
     }
 }
 
+// Interactive sessions see each line as it is written.
+ConsoleSink::Policy Callbacks::consoleFlushPolicy(){
+    RInside* R = RInside::instancePtr() ;
+    return R && R->isInteractive() ? ConsoleSink::FLUSH_LINE : ConsoleSink::FLUSH_FULL ;
+}
+
+void Callbacks::FlushOutput_(){
+    if( sink_m ) sink_m->flush() ;
+}
+
+void Callbacks::FlushConsole_(){
+    FlushOutput_() ;
+    if( has_FlushConsole() ) FlushConsole() ;
+}
+
 void RInside_ShowMessage( const char* message ){
     RInside::instance().callbacks->ShowMessage( message ) ;
 }
@@ -586,7 +848,7 @@ void RInside_ResetConsole(){
 }
 
 void RInside_FlushConsole(){
-    RInside::instance().callbacks->FlushConsole() ;
+    RInside::instance().callbacks->FlushConsole_() ;
 }
 
 void RInside_ClearerrConsole(){
@@ -608,17 +870,17 @@ void RInside::set_callbacks(Callbacks* callbacks_){
     if( callbacks->has_ShowMessage() ){
         ptr_R_ShowMessage = RInside_ShowMessage ;
     }
-    if( callbacks->has_ReadConsole() ){
+    if( callbacks->has_ReadConsole() || callbacks->consoleInput() ){
         ptr_R_ReadConsole = RInside_ReadConsole;
     }
-    if( callbacks->has_WriteConsole() ){
+    if( callbacks->has_WriteConsole() || callbacks->has_WriteConsoleChunk() ){
         ptr_R_WriteConsoleEx = RInside_WriteConsoleEx ;
         ptr_R_WriteConsole = NULL;
         }
     if( callbacks->has_ResetConsole() ){
         ptr_R_ResetConsole = RInside_ResetConsole;
     }
-    if( callbacks->has_FlushConsole() ){
+    if( callbacks->has_FlushConsole() || callbacks->has_WriteConsoleChunk() ){
         ptr_R_FlushConsole = RInside_FlushConsole;
     }
     if( callbacks->has_CleanerrConsole() ){
@@ -0,0 +1,186 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// RInside.h: R/C++ interface class library -- Easier R embedding into C++
+//
+// Copyright (C) 2009         Dirk Eddelbuettel
+// Copyright (C) 2010 - 2017  Dirk Eddelbuettel and Romain Francois
+//
+// This file is part of RInside.
+//
+// RInside is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// RInside is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with RInside.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RINSIDE_RINSIDE_H
+#define RINSIDE_RINSIDE_H
+
+#include <RInsideCommon.h>
+#include <chrono>
+#include <utility>
+#include <Callbacks.h>
+#include <ConsoleInput.h>
+#include <CodeScanner.h>
+#include <ParseCache.h>
+
+class RInside {
+private:
+    MemBuf mb_m;
+    Rcpp::Environment* global_env_m;
+
+    bool verbose_m;                             // private switch
+    bool interactive_m;                         // private switch
+
+    CodeScanner scan_m;                         // state of the input in mb_m
+    ParseCache parse_cache_m;                   // parsed code, by source text
+
+    // Milliseconds spent in each phase of initialize().
+    std::vector<std::pair<std::string, double> > startup_profile_m;
+    std::chrono::steady_clock::time_point startup_mark_m;
+    void markStartup(const char* phase);
+
+    void init_tempdir(void);
+    void init_rand(void);
+    void autoloads(void);
+
+    void initialize(const int argc, const char* const argv[],
+                    const bool loadRcpp, const bool verbose, const bool interactive);
+
+    int evalExprs(SEXP cmdexpr, SEXP env, SEXP &ans); // evaluate an EXPRSXP in env
+    void rewindInput();                         // drop incomplete input
+    void holdBack(const std::string & line);    // keep incomplete input
+
+    static RInside* instance_m ;
+
+#ifdef RINSIDE_CALLBACKS
+    Callbacks* callbacks ;
+    friend void RInside_ShowMessage( const char* message) ;
+    friend void RInside_WriteConsoleEx( const char* message, int len, int oType ) ;
+    friend int RInside_ReadConsole(const char *prompt, unsigned char *buf, int len, int addtohistory) ;
+    friend void RInside_ResetConsole() ;
+    friend void RInside_FlushConsole() ;
+    friend void RInside_ClearerrConsole() ;
+    friend void RInside_Busy(int which) ;
+#endif
+
+public:
+
+    class Proxy {
+    public:
+        Proxy(SEXP xx): x(xx) { };
+
+        template <typename T>
+        operator T() {
+            return ::Rcpp::as<T>(x);
+        }
+    private:
+        Rcpp::RObject x;
+    };
+
+    // Code parsed once by prepare() and evaluated any number of times by
+    // execute(), in an environment of its own (enclosed by the global
+    // environment) that holds the values given to bind(). Assignments
+    // made by the code stay in that environment too. Copies share the
+    // code and the environment.
+    class Statement {
+    public:
+        template <typename T>
+        Statement& bind(const std::string& name, const T& value) {
+            env_m.assign(name, value);
+            return *this;
+        }
+        int   execute(SEXP &ans);                       // evaluate, return in ans; error code rc
+        Proxy execute();                                // evaluate, return SEXP (throws on error)
+        Rcpp::Environment& environment()        { return env_m; }
+    private:
+        friend class RInside;
+        Statement(RInside* owner, SEXP expr, SEXP env);
+        RInside* owner_m;
+        Rcpp::RObject expr_m;
+        Rcpp::Environment env_m;
+    };
+
+    Statement prepare(const std::string &code);         // parse code once (throws on parse error)
+
+    // Result of parseEvalBatch(): values[i] is the value of the last
+    // expression of code[i] (NULL if it failed) and status[i] one of
+    // the codes below.
+    enum { BATCH_OK = 0, BATCH_PARSE_ERROR = 1, BATCH_EVAL_ERROR = 2 };
+    struct BatchResult {
+        Rcpp::List values;
+        std::vector<int> status;
+    };
+
+    // Parses and evaluates each string as a complete script in the
+    // global environment (incomplete code is a parse error). Failures
+    // do not stop the batch.
+    BatchResult parseEvalBatch(const std::vector<std::string> &code);
+
+    int  parseEval(const std::string &line, SEXP &ans); // parse line, return in ans; error code rc
+    void parseEvalQ(const std::string &line);           // parse line, no return (throws on error)
+    void parseEvalQNT(const std::string &line);         // parse line, no return (no throw)
+    Proxy parseEval(const std::string &line);           // parse line, return SEXP (throws on error)
+    Proxy parseEvalNT(const std::string &line);         // parse line, return SEXP (no throw)
+
+    // Code that parses completely is cached by its text, so evaluating
+    // the same string again skips R_ParseVector. At most n strings are
+    // kept (256 by default); 0 disables the cache.
+    void setParseCacheSize(const size_t n)      { parse_cache_m.setCapacity(n); }
+    ParseCache::Stats parseCacheStats() const   { return parse_cache_m.stats(); }
+    void resetParseCacheStats()                 { parse_cache_m.resetStats(); }
+    void clearParseCache()                      { parse_cache_m.clear(); }
+
+    template <typename T>
+    void assign(const T& object, const std::string& nam) {
+        global_env_m->assign( nam, object ) ;
+    }
+
+    RInside() ;
+    RInside(const int argc, const char* const argv[],
+            const bool loadRcpp=true,   // overridden in code, cannot be set to false
+            const bool verbose=false, const bool interactive=false);
+    ~RInside();
+
+    void setVerbose(const bool verbose)         { verbose_m = verbose; }
+    bool isInteractive() const                  { return interactive_m; }
+    void reseed(void);                          // new RNG seeds, after fork()
+
+    // Time taken by each phase of startup, in milliseconds, in order.
+    // Printed at startup when verbose or RINSIDE_STARTUP_PROFILE is set.
+    const std::vector<std::pair<std::string, double> >& startupProfile() const {
+        return startup_profile_m;
+    }
+
+    Rcpp::Environment::Binding operator[]( const std::string& name );
+
+    static RInside& instance();
+    static RInside* instancePtr();
+
+    void repl() ;
+
+    // Feeds R's console (repl(), readline() and friends) from input, a
+    // line at a time straight into R's buffer; 0 restores R's reader.
+    // Not owned: input must outlive its use. Under Unix this replaces
+    // whatever reader is installed, a callbacks' ReadConsole included.
+    void setConsoleInput(ConsoleInput* input);
+
+    // Passes on console output still buffered for the callbacks'
+    // WriteConsoleChunk (done after each evaluation, and before R
+    // reads the console).
+    void flushOutput();
+
+#ifdef RINSIDE_CALLBACKS
+    void set_callbacks(Callbacks* callbacks_) ;
+#endif
+
+};
+
+#endif
@@ -0,0 +1,120 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// RInsideExecutor.cpp: RInside owned by a dedicated thread
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#include <RInsideExecutor.h>
+
+RInsideExecutor::RInsideExecutor(const int argc, const char* const argv[],
+                                 const bool loadRcpp, const bool verbose,
+                                 const bool interactive)
+    : head_m(&stub_m), tail_m(&stub_m), sleeping_m(false), stop_m(false),
+      R_m(0) {
+    stub_m.next.store(0, std::memory_order_relaxed);
+    // R is initialized on the thread that will run it; argv only needs
+    // to live until the constructor returns.
+    std::promise<void> started;
+    std::future<void> ready = started.get_future();
+    thread_m = std::thread(&RInsideExecutor::loop, this, argc, argv, loadRcpp,
+                           verbose, interactive, &started);
+    try {
+        ready.get();
+    } catch (...) {
+        thread_m.join();
+        throw;
+    }
+}
+
+RInsideExecutor::~RInsideExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stop_m.store(true);
+    }
+    cond_m.notify_one();
+    thread_m.join();
+}
+
+void RInsideExecutor::enqueue(Job* job) {
+    push(job);
+    // Pairs with the fence in loop(): either the R thread sees the job
+    // in pop(), or this thread sees it asleep and wakes it. Without it
+    // the store of the link in push() may be ordered after the load.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_m.load()) {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        cond_m.notify_one();
+    }
+}
+
+void RInsideExecutor::push(Job* job) {
+    job->next.store(0, std::memory_order_relaxed);
+    Job* prev = head_m.exchange(job, std::memory_order_acq_rel);
+    prev->next.store(job, std::memory_order_release);
+}
+
+// Returns the oldest job, or 0 if the queue is empty or a producer is
+// half way through push() (it wakes the R thread when done).
+RInsideExecutor::Job* RInsideExecutor::pop() {
+    Job* tail = tail_m;
+    Job* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_m) {
+        if (next == 0)
+            return 0;
+        tail_m = tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != 0) {
+        tail_m = next;
+        return tail;
+    }
+    if (tail != head_m.load(std::memory_order_acquire))
+        return 0;
+    push(&stub_m);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != 0) {
+        tail_m = next;
+        return tail;
+    }
+    return 0;
+}
+
+void RInsideExecutor::loop(int argc, const char* const* argv, bool loadRcpp,
+                           bool verbose, bool interactive,
+                           std::promise<void>* started) {
+    try {
+        R_m = new RInside(argc, argv, loadRcpp, verbose, interactive);
+    } catch (...) {
+        started->set_exception(std::current_exception());
+        return;
+    }
+    started->set_value();
+
+    for (;;) {
+        Job* job = pop();
+        if (job == 0) {
+            // Spin briefly before sleeping: back-to-back submissions
+            // are common and waking a sleeping thread costs far more.
+            for (int spin = 0; spin < 64 && job == 0; spin++) {
+                std::this_thread::yield();
+                job = pop();
+            }
+        }
+        if (job == 0) {
+            std::unique_lock<std::mutex> lock(mutex_m);
+            sleeping_m.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while ((job = pop()) == 0 && !stop_m.load())
+                cond_m.wait(lock);
+            sleeping_m.store(false);
+        }
+        if (job == 0)
+            break;              // stopped, and nothing left to run
+        job->run(*R_m);
+        delete job;
+    }
+
+    delete R_m;
+    R_m = 0;
+}
@@ -0,0 +1,196 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// RInsideExecutor.h: RInside owned by a dedicated thread
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#ifndef RINSIDE_RINSIDEEXECUTOR_H
+#define RINSIDE_RINSIDEEXECUTOR_H
+
+#include <RInside.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#define RINSIDE_COROUTINES
+#endif
+
+// Runs the (single) RInside instance on a thread of its own, so that
+// any number of threads can use R without serializing calls themselves
+// and without ever touching the R API off the R thread. Work is
+// submitted as jobs, functions taking the RInside instance, to a
+// lock-free multiple-producer queue that the R thread drains in order;
+// results (and exceptions) come back through std::future.
+//
+// Jobs must not let SEXPs escape: convert results to C++ values on the
+// R thread, as parseEval<T>() does. A job submitted from the R thread
+// itself (from inside another job) runs immediately, so waiting on its
+// future cannot deadlock.
+class RInsideExecutor {
+public:
+    RInsideExecutor(const int argc = 0, const char* const argv[] = 0,
+                    const bool loadRcpp = true, const bool verbose = false,
+                    const bool interactive = false);
+
+    // Runs the jobs already queued, then shuts R down and joins the
+    // thread. No job may be submitted once destruction has started.
+    ~RInsideExecutor();
+
+    // Queues fn(R) and returns a future for its result.
+    template <typename F>
+    std::future<std::invoke_result_t<F, RInside&> > submit(F fn) {
+        typedef std::invoke_result_t<F, RInside&> T;
+        TaskJob<T>* job = new TaskJob<T>(std::move(fn));
+        std::future<T> result = job->task.get_future();
+        if (onRThread()) {
+            job->run(*R_m);
+            delete job;
+        } else {
+            enqueue(job);
+        }
+        return result;
+    }
+
+    // parseEval(code) on the R thread, converted to T there.
+    template <typename T>
+    std::future<T> parseEval(const std::string& code) {
+        return submit([code](RInside& R) -> T { return R.parseEval(code); });
+    }
+
+    std::future<void> parseEvalQ(const std::string& code) {
+        return submit([code](RInside& R) { R.parseEvalQ(code); });
+    }
+
+    // Queues fn(R) with no way to wait for it; exceptions are dropped.
+    template <typename F>
+    void post(F fn) {
+        enqueue(new PostJob<F>(std::move(fn)));
+    }
+
+    bool onRThread() const { return std::this_thread::get_id() == thread_m.get_id(); }
+
+#ifdef RINSIDE_COROUTINES
+    // Called with a suspended coroutine to resume it, typically by
+    // posting it to the event loop or thread pool it came from.
+    typedef std::function<void(std::coroutine_handle<>)> Resumer;
+
+    // Result of evalAsync(): co_await suspends the coroutine, queues the
+    // code for the R thread and yields its value converted to T (nothing
+    // for void), or rethrows the error, once the coroutine is resumed.
+    template <typename T>
+    class EvalAwaiter {
+    public:
+        EvalAwaiter(RInsideExecutor* ex, std::string code, Resumer resume)
+            : ex_m(ex), code_m(std::move(code)), resume_m(std::move(resume)) {}
+
+        bool await_ready() const { return false; }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            ex_m->post([this, h](RInside& R) {
+                try {
+                    if constexpr (std::is_void_v<T>)
+                        R.parseEvalQ(code_m);
+                    else
+                        value_m.emplace(R.parseEval(code_m));
+                } catch (...) {
+                    error_m = std::current_exception();
+                }
+                // The resumed coroutine may destroy this awaiter at
+                // once, on another thread, so nothing of it is used
+                // after resume_m has been moved out.
+                Resumer resume = std::move(resume_m);
+                if (resume)
+                    resume(h);
+                else
+                    h.resume();
+            });
+        }
+
+        T await_resume() {
+            if (error_m)
+                std::rethrow_exception(error_m);
+            if constexpr (!std::is_void_v<T>)
+                return std::move(*value_m);
+        }
+
+    private:
+        RInsideExecutor* ex_m;
+        std::string code_m;
+        Resumer resume_m;
+        std::conditional_t<std::is_void_v<T>, char, std::optional<T>> value_m;
+        std::exception_ptr error_m;
+    };
+
+    // co_await ex.evalAsync<double>("mean(x)", resume) evaluates code on
+    // the R thread without blocking the awaiting thread, and resumes the
+    // coroutine through resume. Without a resumer the coroutine resumes
+    // on the R thread, and so must not block there. Any number of
+    // coroutines can have evaluations queued at once; they run in order.
+    template <typename T = void>
+    EvalAwaiter<T> evalAsync(std::string code, Resumer resume = Resumer()) {
+        return EvalAwaiter<T>(this, std::move(code), std::move(resume));
+    }
+#endif
+
+private:
+    RInsideExecutor(const RInsideExecutor&);
+    RInsideExecutor& operator=(const RInsideExecutor&);
+
+    struct Job {
+        std::atomic<Job*> next;
+        virtual ~Job() {}
+        virtual void run(RInside& R) {}
+    };
+
+    template <typename T>
+    struct TaskJob : Job {
+        template <typename F>
+        explicit TaskJob(F fn) : task(std::move(fn)) {}
+        void run(RInside& R) { task(R); }
+        std::packaged_task<T(RInside&)> task;
+    };
+
+    template <typename F>
+    struct PostJob : Job {
+        explicit PostJob(F fn) : fn_m(std::move(fn)) {}
+        void run(RInside& R) {
+            try { fn_m(R); } catch (...) {}
+        }
+        F fn_m;
+    };
+
+    void enqueue(Job* job);
+    void push(Job* job);
+    Job* pop();
+    void loop(int argc, const char* const* argv, bool loadRcpp,
+              bool verbose, bool interactive, std::promise<void>* started);
+
+    // Intrusive MPSC queue (D. Vyukov): producers exchange head_m,
+    // the R thread alone follows the next links from tail_m. stub_m
+    // keeps the list non-empty.
+    std::atomic<Job*> head_m;
+    Job* tail_m;
+    Job stub_m;
+
+    // The R thread sleeps on cond_m only after finding the queue empty
+    // with sleeping_m set, so producers take mutex_m only to wake it.
+    std::mutex mutex_m;
+    std::condition_variable cond_m;
+    std::atomic<bool> sleeping_m, stop_m;
+
+    RInside* R_m;
+    std::thread thread_m;
+};
+
+#endif
@@ -0,0 +1,187 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// RInsideRepl.cpp: step-wise, non-blocking REPL for RInside
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#include <RInsideRepl.h>
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include <Rinterface.h>
+#include <R_ext/eventloop.h>
+
+// Longest piece of a line R_ReplDLLdo1 takes at once: its console
+// buffer (CONSOLE_BUFFER_SIZE) less the terminating NUL.
+static const std::size_t MAX_PIECE = 4095;
+
+std::size_t RInsideRepl::Input::readLine(char* buf, std::size_t len) {
+    std::size_t avail = buf_m.size() - begin_m, n;
+    if (avail == 0 && !eof_m) {
+        // Not expected, as R only runs with a line queued: an empty
+        // line keeps the session going where an empty read would end it.
+        buf[0] = '\n';
+        n = 1;
+    } else {
+        n = lineLength(buf_m.data() + begin_m, avail, len - 1, true);
+        memcpy(buf, buf_m.data() + begin_m, n);
+        begin_m += n;
+        if (begin_m == buf_m.size()) {
+            buf_m.clear();
+            begin_m = 0;
+        } else if (begin_m > 65536 && 2*begin_m > buf_m.size()) {
+            buf_m.erase(buf_m.begin(), buf_m.begin() + begin_m);
+            begin_m = 0;
+        }
+    }
+    buf[n] = '\0';
+    // R_ReplDLLdo1 steps over the NUL ending a piece that has no ';' or
+    // newline at its end, and reads again only if the next byte is NUL.
+    if (n + 1 < len)
+        buf[n + 1] = '\0';
+
+    // R_ReplDLLdo1 takes one statement per call, up to each ';' or
+    // newline; step() keeps calling it until the piece is used up.
+    pieces_m = 0;
+    for (std::size_t i = 0; i < n; i++)
+        if (buf[i] == ';' || buf[i] == '\n')
+            pieces_m++;
+    if (n > 0 && buf[n - 1] != ';' && buf[n - 1] != '\n')
+        pieces_m++;
+    return n;
+}
+
+bool RInsideRepl::Input::ready() const {
+    std::size_t avail = buf_m.size() - begin_m;
+    return eof_m || avail >= MAX_PIECE ||
+        (avail > 0 && memchr(buf_m.data() + begin_m, '\n', avail) != NULL);
+}
+
+bool RInsideRepl::Input::append(int fd) {
+    std::size_t used = buf_m.size();
+    buf_m.resize(used + 65536);
+    ssize_t n;
+    do n = read(fd, &buf_m[used], 65536); while (n < 0 && errno == EINTR);
+    buf_m.resize(used + (n > 0 ? n : 0));
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return true;
+    if (n <= 0)
+        eof_m = true;
+    return n > 0;
+}
+
+RInsideRepl::RInsideRepl(RInside& R, int fd)
+    : R_m(R), fd_m(fd), prompt_m(isatty(fd) != 0), finished_m(false),
+      prompted_m(false), status_m(1) {
+    R_m.setConsoleInput(&input_m);
+    R_ReplDLLinit();                    // empty console buffers
+}
+
+RInsideRepl::~RInsideRepl() {
+    R_m.setConsoleInput(0);
+}
+
+void RInsideRepl::doOne(void* data) {
+    RInsideRepl* repl = static_cast<RInsideRepl*>(data);
+    repl->status_m = R_ReplDLLdo1();
+}
+
+void RInsideRepl::showPrompt() {
+    SEXP prompt = Rf_GetOption1(Rf_install(status_m == 2 ? "continue" : "prompt"));
+    if (TYPEOF(prompt) == STRSXP && LENGTH(prompt) > 0)
+        Rprintf("%s", CHAR(STRING_ELT(prompt, 0)));
+    R_FlushConsole();
+}
+
+bool RInsideRepl::step() {
+    while (!finished_m && (input_m.pieces() > 0 || input_m.ready())) {
+        prompted_m = false;
+        // R_ReplDLLdo1 has no top-level context of its own: an error
+        // would jump back into R_ReplDLLinit, long returned. Under
+        // R_ToplevelExec it ends here, and the console buffers are reset
+        // instead, dropping the rest of the line as R's REPL does.
+        if (!R_ToplevelExec(doOne, this)) {
+            R_ReplDLLinit();
+            input_m.dropPieces();
+            status_m = 1;
+            continue;
+        }
+        if (status_m < 0)
+            finished_m = true;          // end of input
+        else
+            input_m.usePiece();
+    }
+    R_FlushConsole();
+    if (!finished_m && prompt_m && !prompted_m) {
+        showPrompt();
+        prompted_m = true;
+    }
+    return !finished_m;
+}
+
+bool RInsideRepl::onReadable() {
+    input_m.append(fd_m);
+    return step();
+}
+
+static void runHandlers(void* mask) {
+    R_runHandlers(R_InputHandlers, static_cast<fd_set*>(mask));
+}
+
+void RInsideRepl::processEvents() {
+    fd_set* what = R_checkActivity(0, 1);
+    if (what != NULL)
+        R_ToplevelExec(runHandlers, what);
+}
+
+bool RInsideRepl::poll(int timeout_ms) {
+    if (!step())
+        return false;
+
+    std::vector<struct pollfd> fds(1);
+    fds[0].fd = fd_m;
+    fds[0].events = POLLIN;
+    for (InputHandler* h = R_InputHandlers; h != NULL; h = h->next) {
+        if (h->handler == NULL || h->fileDescriptor < 0 || h->fileDescriptor == fd_m)
+            continue;
+        struct pollfd p;
+        p.fd = h->fileDescriptor;
+        p.events = POLLIN;
+        fds.push_back(p);
+    }
+    // Graphics devices and the like ask to be polled every R_wait_usec.
+    if (R_wait_usec > 0 && (timeout_ms < 0 || timeout_ms > R_wait_usec/1000))
+        timeout_ms = R_wait_usec/1000 > 0 ? R_wait_usec/1000 : 1;
+    for (size_t i = 0; i < fds.size(); i++)
+        fds[i].revents = 0;
+    int n = ::poll(&fds[0], fds.size(), timeout_ms);
+    if (R_PolledEvents != NULL)
+        R_PolledEvents();
+    if (n <= 0)
+        return !finished_m;             // timeout, or EINTR
+
+    fd_set mask;
+    FD_ZERO(&mask);
+    bool handlers = false;
+    for (size_t i = 1; i < fds.size(); i++) {
+        if (fds[i].revents != 0 && fds[i].fd < FD_SETSIZE) {
+            FD_SET(fds[i].fd, &mask);
+            handlers = true;
+        }
+    }
+    if (handlers)
+        R_ToplevelExec(runHandlers, &mask);
+    if (fds[0].revents != 0)
+        return onReadable();
+    return step();
+}
+
+#endif
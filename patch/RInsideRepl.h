@@ -0,0 +1,100 @@
+// -*- mode: C++; c-indent-level: 4; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+//
+// RInsideRepl.h: step-wise, non-blocking REPL for RInside
+//
+// This file is part of the CRcpp patches to RInside, and is distributed
+// under the same terms (GNU GPL, version 2 or later).
+
+#ifndef RINSIDE_RINSIDEREPL_H
+#define RINSIDE_RINSIDEREPL_H
+
+#include <RInside.h>
+
+#ifndef _WIN32
+
+#include <cstddef>
+#include <vector>
+
+// A REPL that never waits for input inside R, unlike RInside::repl()
+// (run_Rmainloop), so it can share a thread with other work driven by
+// an event loop. Input read from fd is queued, and each complete line
+// is run through R_ReplDLLdo1, one top-level iteration at a time, with
+// the same parsing, printing, warnings and top-level task callbacks as
+// R's own REPL. An error ends the line it occurred on, as in R.
+//
+// With an event loop of one's own, poll fd() for input, call
+// onReadable() when it is readable, and call processEvents() now and
+// then for R's input handlers (Tcl/Tk, httpuv, ...):
+//
+//     RInsideRepl repl(R, fd);
+//     ... add repl.fd() to the epoll set ...
+//     if (ready(repl.fd()) && !repl.onReadable()) done();
+//
+// or let poll() do all three. R itself is only entered from these
+// calls, on the thread that owns RInside. Unix only; the console input
+// of RInside (RInside::setConsoleInput) belongs to the REPL while it
+// exists.
+class RInsideRepl {
+public:
+    explicit RInsideRepl(RInside& R, int fd = 0);
+    ~RInsideRepl();
+
+    int fd() const { return fd_m; }
+
+    // Reads what is available on fd (one read(), which does not block
+    // when fd is readable) and runs the complete lines. Returns false
+    // once the session has ended: end of input, or quit().
+    bool onReadable();
+
+    // Runs what is already queued, without reading; false as above.
+    bool step();
+
+    // Runs R's input handlers that have activity, without waiting.
+    void processEvents();
+
+    // Waits up to timeout_ms (-1: no limit) for input on fd or on R's
+    // input handlers and dispatches it; false once the session ended.
+    bool poll(int timeout_ms);
+
+    // Print R's prompt ("> ", or "+ " inside an expression) when the
+    // REPL is waiting for input. On by default if fd is a terminal.
+    void setPrompt(bool prompt) { prompt_m = prompt; }
+
+    bool finished() const { return finished_m; }
+
+private:
+    RInsideRepl(const RInsideRepl&);
+    RInsideRepl& operator=(const RInsideRepl&);
+
+    // The queued input, handed to R_ReplDLLdo1 through R's console.
+    class Input : public ConsoleInput {
+    public:
+        Input() : begin_m(0), eof_m(false), pieces_m(0) {}
+        std::size_t readLine(char* buf, std::size_t len);
+        bool ready() const;                     // a line can be handed out
+        bool append(int fd);                    // false at end of file
+        std::size_t pieces() const { return pieces_m; }
+        void usePiece() { if (pieces_m > 0) pieces_m--; }
+        void dropPieces() { pieces_m = 0; }
+    private:
+        std::vector<char> buf_m;
+        std::size_t begin_m;                    // unread input from here
+        bool eof_m;
+        std::size_t pieces_m;                   // statements R still holds
+    };
+
+    static void doOne(void* data);
+    void showPrompt();
+
+    RInside& R_m;
+    int fd_m;
+    Input input_m;
+    bool prompt_m;
+    bool finished_m;
+    bool prompted_m;                            // prompt shown, no input since
+    int status_m;                               // last R_ReplDLLdo1 result
+};
+
+#endif
+
+#endif
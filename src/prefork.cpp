@@ -0,0 +1,82 @@
+// Pre-fork worker mode of CRcpp (see prefork.h).
+#include "prefork.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <Rinternals.h>
+
+#ifdef _WIN32
+
+int preforkRun(RInside& R, int nworkers,
+               const std::function<int(RInside&, int)>& work) {
+    fprintf(stderr, "CRcpp: pre-fork workers need fork(), not available "
+            "under Windows\n");
+    return 1;
+}
+
+#else
+
+int preforkRun(RInside& R, int nworkers,
+               const std::function<int(RInside&, int)>& work) {
+
+    // Collect garbage now, so children do not each find (and copy, by
+    // touching their pages) the garbage left by startup.
+    R_gc();
+    fflush(stdout);
+    fflush(stderr);
+
+    std::vector<pid_t> pids;
+    for (int i = 1; i <= nworkers; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("CRcpp: fork");
+            break;
+        }
+        if (pid == 0) {
+            int status = 1;
+            try {
+                R.reseed();
+                R.assign(i, "worker.id");
+                status = work(R, i);
+            } catch (std::exception& ex) {
+                fprintf(stderr, "CRcpp: worker %d: %s\n", i, ex.what());
+            }
+            // The parent owns R's shutdown (.Last, finalizers, temporary
+            // directory): leave without running it again here.
+            fflush(stdout);
+            fflush(stderr);
+            _exit(status);
+        }
+        pids.push_back(pid);
+    }
+
+    int failed = (int)pids.size() < nworkers;
+    for (size_t i = 0; i < pids.size(); i++) {
+        int status;
+        pid_t rc;
+        do rc = waitpid(pids[i], &status, 0); while (rc < 0 && errno == EINTR);
+        if (rc < 0) {
+            perror("CRcpp: waitpid");
+            failed = 1;
+        } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "CRcpp: worker %d (pid %d) exited with status %d\n",
+                    (int)i + 1, (int)pids[i], WEXITSTATUS(status));
+            failed = 1;
+        } else if (WIFSIGNALED(status)) {
+            fprintf(stderr, "CRcpp: worker %d (pid %d) killed by signal %d\n",
+                    (int)i + 1, (int)pids[i], WTERMSIG(status));
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+#endif
@@ -0,0 +1,20 @@
+// Pre-fork worker mode of CRcpp: the interpreter is initialized once in
+// the parent, and workers are forked from it, inheriting the warm R
+// heap (base and loaded packages) copy-on-write.
+#ifndef CRCPP_PREFORK_H
+#define CRCPP_PREFORK_H
+
+#include <RInside.h>
+
+#include <functional>
+
+// Runs work(R, i) in each of nworkers children forked from the
+// initialized interpreter R, i = 1..nworkers, and waits for them.
+// Each child is reseeded first (RInside::reseed) and has worker.id set
+// to i in the global environment; its exit status is the value that
+// work returns. Returns 0 if every worker exited with status 0, and 1
+// otherwise (or if fork() is not available, as under Windows).
+int preforkRun(RInside& R, int nworkers,
+               const std::function<int(RInside&, int)>& work);
+
+#endif
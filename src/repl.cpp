@@ -3,24 +3,228 @@
 // has the advantage of being part of RInside, and not
 // separate app, useful for interacting with R while
 // debugging.
+//
+// Options (anything else is passed on to R as argv):
+//   --packages pkg,...  attach packages after startup
+//   -e, --eval code     evaluate code and exit instead of the REPL
+//   --file script.R     source script.R and exit instead of the REPL
+//   --prefork N         initialize R (and the packages) once, then run
+//                       the code or script (or --listen) in N forked
+//                       workers
+//   --worker FD         serve jobs from the supervisor library on the
+//                       socket FD (see supervisor/Supervisor.h)
+//   --listen ADDR       after any code or script, serve evaluation
+//                       requests on unix:/path or tcp:host:port (see
+//                       supervisor/Client.h); there is no
+//                       authentication, so a TCP host must be loopback
+//   --snapshot out.rds  after the packages and any code or script, save
+//                       the session to out.rds and exit
+//   --restore in.rds    start from a session saved with --snapshot
+//
+// With standard input redirected (CRcpp < script.R, or a pipe), the REPL
+// reads it through a buffer straight into R's console, without prompts;
+// under Unix it runs step-wise (RInsideRepl), serving R's input handlers
+// between lines.
 #include <RInside.h>
 
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <RInsideRepl.h>
+#endif
+
+#include "prefork.h"
+#include "snapshot.h"
+#ifndef _WIN32
+#include "server.h"
+#include "worker.h"
+#endif
+
 extern "C" {
     void CRcppBuildRcpp(void);
     void CRcppBuildRInside(void);
 }
 
+struct Options {
+    std::vector<std::string> packages;
+    std::string eval, file;
+    std::string snapshot, restore;
+    std::string listen;         // server address
+    int prefork;
+    int worker;                 // socket from the supervisor, or -1
+    std::vector<char*> rargv;   // arguments left for R
+};
+
+static void usage() {
+    fprintf(stderr,
+            "Usage: CRcpp [--packages pkg,...] [-e code | --file script.R]\n"
+            "             [--prefork N] [--listen ADDR]\n"
+            "             [--worker FD | --snapshot out.rds]\n"
+            "             [--restore in.rds] [args...]\n");
+    exit(2);
+}
+
+static Options parseArgs(int argc, char *argv[]) {
+    Options opt;
+    opt.prefork = 0;
+    opt.worker = -1;
+    opt.rargv.push_back(argv[0]);
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool known = !strcmp(arg, "--packages") || !strcmp(arg, "-e") ||
+            !strcmp(arg, "--eval") || !strcmp(arg, "--file") ||
+            !strcmp(arg, "--prefork") || !strcmp(arg, "--worker") ||
+            !strcmp(arg, "--snapshot") || !strcmp(arg, "--restore") ||
+            !strcmp(arg, "--listen");
+        if (!known) {
+            opt.rargv.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc)
+            usage();
+        std::string val = argv[++i];
+        if (!strcmp(arg, "--packages")) {
+            std::stringstream ss(val);
+            std::string pkg;
+            while (std::getline(ss, pkg, ','))
+                if (!pkg.empty())
+                    opt.packages.push_back(pkg);
+        } else if (!strcmp(arg, "--file")) {
+            opt.file = val;
+        } else if (!strcmp(arg, "--prefork")) {
+            opt.prefork = atoi(val.c_str());
+            if (opt.prefork < 1)
+                usage();
+        } else if (!strcmp(arg, "--listen")) {
+            opt.listen = val;
+        } else if (!strcmp(arg, "--snapshot")) {
+            opt.snapshot = val;
+        } else if (!strcmp(arg, "--restore")) {
+            opt.restore = val;
+        } else if (!strcmp(arg, "--worker")) {
+            opt.worker = atoi(val.c_str());
+            if (opt.worker < 0)
+                usage();
+        } else {
+            opt.eval = val;
+        }
+    }
+    if (opt.prefork > 0 && opt.eval.empty() && opt.file.empty() &&
+        opt.listen.empty()) {
+        fprintf(stderr, "CRcpp: --prefork needs -e, --file or --listen\n");
+        usage();
+    }
+    if (!opt.snapshot.empty() && (opt.prefork > 0 || opt.worker >= 0 ||
+                                  !opt.listen.empty())) {
+        fprintf(stderr, "CRcpp: --snapshot cannot be used with --prefork, "
+                "--worker or --listen\n");
+        usage();
+    }
+    if (!opt.listen.empty() && opt.worker >= 0) {
+        fprintf(stderr, "CRcpp: --listen cannot be used with --worker\n");
+        usage();
+    }
+    return opt;
+}
+
+// Runs the -e code or --file script; returns the exit status.
+static int runJob(RInside& R, const Options& opt) {
+    try {
+        if (!opt.file.empty()) {
+            Rcpp::Function source("source");
+            source(opt.file);
+        }
+        if (!opt.eval.empty())
+            R.parseEvalQ(opt.eval);
+    } catch (std::exception& ex) {
+        fprintf(stderr, "CRcpp: %s\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
 
     // Do not uncomment: this will cause a seg fault because
     // Rprintf is used before R is initialized.
     //CRcppBuildRcpp();
-    
-    RInside R(argc, argv, false, false, false);
+
+    Options opt = parseArgs(argc, argv);
+
+    RInside R((int)opt.rargv.size(), &opt.rargv[0], false, false, false);
     CRcppBuildRcpp();
     CRcppBuildRInside();
+
+    if (!opt.restore.empty() && snapshotRestore(R, opt.restore) != 0)
+        exit(1);
+
+    Rcpp::Function library("library");
+    for (size_t i = 0; i < opt.packages.size(); i++) {
+        try {
+            library(opt.packages[i], Rcpp::Named("character.only") = true);
+        } catch (std::exception& ex) {
+            fprintf(stderr, "CRcpp: cannot load %s: %s\n",
+                    opt.packages[i].c_str(), ex.what());
+            exit(1);
+        }
+    }
+
+    // The code or script is the warmup whose result is saved.
+    if (!opt.snapshot.empty()) {
+        int status = opt.eval.empty() && opt.file.empty() ? 0 : runJob(R, opt);
+        exit(status != 0 ? status : snapshotSave(R, opt.snapshot));
+    }
+    if (opt.worker >= 0) {
+#ifndef _WIN32
+        exit(workerRun(R, opt.worker));
+#else
+        fprintf(stderr, "CRcpp: worker mode is not available under Windows\n");
+        exit(1);
+#endif
+    }
+    if (!opt.listen.empty()) {
+#ifndef _WIN32
+        // The code or script warms the session up first. The socket is
+        // opened before any fork, and the workers share it.
+        if ((!opt.eval.empty() || !opt.file.empty()) && runJob(R, opt) != 0)
+            exit(1);
+        int listener = serverListen(opt.listen);
+        if (listener < 0)
+            exit(1);
+        if (opt.prefork > 0)
+            exit(preforkRun(R, opt.prefork, [listener](RInside& worker, int) {
+                return serverRun(worker, listener);
+            }));
+        exit(serverRun(R, listener));
+#else
+        fprintf(stderr, "CRcpp: server mode is not available under Windows\n");
+        exit(1);
+#endif
+    }
+    if (opt.prefork > 0)
+        exit(preforkRun(R, opt.prefork, [&opt](RInside& worker, int) {
+            return runJob(worker, opt);
+        }));
+    if (!opt.eval.empty() || !opt.file.empty())
+        exit(runJob(R, opt));
+
     R.parseEval("options(prompt = 'R > ')");
+#ifndef _WIN32
+    if (!isatty(fileno(stdin))) {
+        RInsideRepl repl(R, fileno(stdin));
+        while (repl.poll(-1)) {}
+        exit(0);
+    }
+#else
+    FdInput input(fileno(stdin));
+    if (!isatty(fileno(stdin)))
+        R.setConsoleInput(&input);
+#endif
     R.repl() ;
     exit(0);
 }
-
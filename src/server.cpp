@@ -0,0 +1,184 @@
+// Server mode of CRcpp (see server.h and supervisor/Protocol.h).
+#include "server.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <Rinternals.h>
+
+#include "Protocol.h"
+
+using namespace crcpp;
+
+int serverListen(const std::string& address) {
+    std::string error;
+    int fd = listenSocket(address, &error);
+    if (fd < 0) {
+        fprintf(stderr, "CRcpp: %s\n", error.c_str());
+        return -1;
+    }
+    // Several processes may wait on the socket: those that lose the
+    // race for a connection must not block in accept().
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static std::string header(uint32_t status, uint32_t type, uint64_t length,
+                          const std::string& message) {
+    std::string head;
+    put32(head, status);
+    put32(head, type);
+    put64(head, length);
+    put64(head, message.size());
+    head += message;
+    return head;
+}
+
+// R_Serialize output appended to a std::string.
+static void outChar(R_outpstream_t stream, int c) {
+    static_cast<std::string*>(stream->data)->push_back((char)c);
+}
+
+static void outBytes(R_outpstream_t stream, void* buf, int len) {
+    static_cast<std::string*>(stream->data)->append(static_cast<char*>(buf), len);
+}
+
+struct SerializeArgs {
+    SEXP value;
+    std::string* out;
+};
+
+// Run under R_ToplevelExec: an object that cannot be serialized (an
+// external pointer with a hook that fails, say) makes an R error.
+static void serializeValue(void* data) {
+    SerializeArgs* args = static_cast<SerializeArgs*>(data);
+    struct R_outpstream_st out;
+    R_InitOutPStream(&out, (R_pstream_data_t)args->out, R_pstream_xdr_format, 3,
+                     outChar, outBytes, NULL, R_NilValue);
+    R_Serialize(args->value, &out);
+}
+
+// Evaluates one request and sends the response; false if the client
+// has gone.
+static bool serve(RInside& R, int sock, const std::string& req) {
+    Reader rd(req);
+    uint32_t magic = rd.get32();
+    uint32_t format = rd.get32();
+    std::string code = rd.getString(rd.get64());
+    if (!rd.ok() || magic != SERVER_MAGIC || format > FORMAT_SERIALIZED)
+        return sendMessage(sock, header(STATUS_BAD_REQUEST, VEC_DOUBLE, 0,
+                                        "malformed request"));
+
+    // parseEvalBatch goes through the parse cache, and treats the code
+    // as a whole script: incomplete code is an error, not held back for
+    // the next request.
+    RInside::BatchResult res = R.parseEvalBatch(std::vector<std::string>(1, code));
+    if (res.status[0] != RInside::BATCH_OK) {
+        std::string msg = res.status[0] == RInside::BATCH_PARSE_ERROR ?
+            std::string("parse error") :
+            Rcpp::as<std::string>(R.parseEval("geterrmessage()"));
+        return sendMessage(sock, header(STATUS_R_ERROR, VEC_DOUBLE, 0, msg));
+    }
+    Rcpp::RObject value(VECTOR_ELT(res.values, 0));
+
+    if (format == FORMAT_SERIALIZED) {
+        std::string body;
+        SerializeArgs args = { value, &body };
+        if (!R_ToplevelExec(serializeValue, &args))
+            return sendMessage(sock, header(STATUS_BAD_RESULT, VEC_DOUBLE, 0,
+                                            "cannot serialize the result"));
+        return sendMessage(sock, header(STATUS_OK, VEC_SERIALIZED, body.size(), ""),
+                           body.data(), body.size());
+    }
+
+    // Vectors are sent straight from R's memory.
+    switch (TYPEOF(value)) {
+    case NILSXP:
+        return sendMessage(sock, header(STATUS_OK, VEC_DOUBLE, 0, ""));
+    case CPLXSXP:
+        return sendMessage(sock, header(STATUS_OK, VEC_COMPLEX, XLENGTH(value), ""),
+                           COMPLEX(value), XLENGTH(value)*elementSize(VEC_COMPLEX));
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+        value = Rf_coerceVector(value, REALSXP);
+        return sendMessage(sock, header(STATUS_OK, VEC_DOUBLE, XLENGTH(value), ""),
+                           REAL(value), XLENGTH(value)*elementSize(VEC_DOUBLE));
+    default:
+        return sendMessage(sock, header(STATUS_BAD_RESULT, VEC_DOUBLE, 0,
+                                        std::string("result of type ") +
+                                        Rf_type2char(TYPEOF(value)) +
+                                        " is not numeric, complex or NULL"));
+    }
+}
+
+int serverRun(RInside& R, int listener) {
+    signal(SIGPIPE, SIG_IGN);           // clients may leave mid-response
+
+    std::vector<struct pollfd> fds(1);
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+    for (;;) {
+        for (size_t i = 0; i < fds.size(); i++)
+            fds[i].revents = 0;
+        if (poll(&fds[0], fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("CRcpp: poll");
+            return 1;
+        }
+
+        // A request is read whole once it starts arriving, so a client
+        // that stops halfway through one holds up the others.
+        for (size_t i = fds.size() - 1; i > 0; i--) {
+            if (fds[i].revents == 0)
+                continue;
+            bool ok;
+            try {
+                std::string req;
+                std::vector<int> rfds;
+                ok = recvMessage(fds[i].fd, req, rfds, MAX_REQUEST);
+                for (size_t k = 0; k < rfds.size(); k++)
+                    close(rfds[k]);
+                ok = ok && serve(R, fds[i].fd, req);
+            } catch (std::exception& ex) {
+                fprintf(stderr, "CRcpp: %s\n", ex.what());
+                ok = false;
+            }
+            if (!ok) {
+                close(fds[i].fd);
+                fds.erase(fds.begin() + i);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int sock = accept(listener, NULL, NULL);
+            if (sock < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+                    errno != ECONNABORTED)
+                    perror("CRcpp: accept");
+                continue;
+            }
+            // BSD passes O_NONBLOCK on from the listening socket.
+            fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) & ~O_NONBLOCK);
+            fcntl(sock, F_SETFD, FD_CLOEXEC);
+            int one = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            struct pollfd p;
+            p.fd = sock;
+            p.events = POLLIN;
+            p.revents = 0;
+            fds.push_back(p);
+        }
+    }
+}
@@ -0,0 +1,20 @@
+// Server mode of CRcpp: CRcpp --listen unix:/path or tcp:host:port
+// serves evaluation requests from local clients (supervisor/Client.h)
+// with the interpreter already warm.
+#ifndef CRCPP_SERVER_H
+#define CRCPP_SERVER_H
+
+#include <RInside.h>
+
+#include <string>
+
+// Returns a listening socket for address, or -1 after printing why.
+int serverListen(const std::string& address);
+
+// Accepts connections on the listening socket and serves their requests
+// (supervisor/Protocol.h) until killed, one request at a time. Several
+// processes may serve the same socket (--prefork). Returns the exit
+// status for CRcpp.
+int serverRun(RInside& R, int listener);
+
+#endif
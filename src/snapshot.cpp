@@ -0,0 +1,247 @@
+// Startup snapshots for CRcpp (see snapshot.h).
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <Rinternals.h>
+
+static const char* SNAPSHOT_FORMAT = "CRcpp snapshot 1";
+
+// Bindings that describe this process rather than the warm state.
+static bool skipped(const char* name) {
+    return !strcmp(name, ".Random.seed") || !strcmp(name, "argv") ||
+        !strcmp(name, "worker.id");
+}
+
+// Named list of the values in the global environment. Unforced promises
+// (the autoloads among them) and active bindings are skipped: reading
+// them would load packages, or run code, just to save them.
+static SEXP globals() {
+    SEXP names = PROTECT(R_lsInternal3(R_GlobalEnv, TRUE, FALSE));
+    int n = LENGTH(names), k = 0;
+    SEXP values = PROTECT(Rf_allocVector(VECSXP, n));
+    SEXP kept = PROTECT(Rf_allocVector(STRSXP, n));
+    for (int i = 0; i < n; i++) {
+        const char* name = CHAR(STRING_ELT(names, i));
+        SEXP sym = Rf_install(name);
+        if (skipped(name) || R_BindingIsActive(sym, R_GlobalEnv))
+            continue;
+        SEXP value = Rf_findVarInFrame(R_GlobalEnv, sym);
+        if (TYPEOF(value) == PROMSXP) {
+            if (PRVALUE(value) == R_UnboundValue)
+                continue;
+            value = PRVALUE(value);
+        }
+        SET_VECTOR_ELT(values, k, value);
+        SET_STRING_ELT(kept, k, STRING_ELT(names, i));
+        k++;
+    }
+    values = PROTECT(Rf_lengthgets(values, k));
+    Rf_setAttrib(values, R_NamesSymbol, Rf_lengthgets(kept, k));
+    UNPROTECT(4);
+    return values;
+}
+
+struct SaveArgs {
+    SEXP object;
+    FILE* fp;
+};
+
+// Run under R_ToplevelExec, so that an error while serializing returns
+// here instead of jumping out of CRcpp.
+static void save(void* data) {
+    SaveArgs* args = static_cast<SaveArgs*>(data);
+    struct R_outpstream_st out;
+    R_InitFileOutPStream(&out, args->fp, R_pstream_xdr_format, 3, NULL, R_NilValue);
+    R_Serialize(args->object, &out);
+}
+
+int snapshotSave(RInside& R, const std::string& path) {
+    try {
+        Rcpp::List snapshot = Rcpp::List::create(
+            Rcpp::Named("format") = SNAPSHOT_FORMAT,
+            Rcpp::Named("namespaces") = R.parseEval("loadedNamespaces()"),
+            Rcpp::Named("attached") = R.parseEval(
+                "sub('^package:', '', grep('^package:', search(), value = TRUE))"),
+            Rcpp::Named("globals") = Rcpp::RObject(globals()));
+
+        // Written next to path and renamed into place, so a process
+        // restoring from path never sees half a snapshot.
+        std::string tmp = path + ".tmp";
+        FILE* fp = fopen(tmp.c_str(), "wb");
+        if (fp == NULL) {
+            perror(("CRcpp: " + tmp).c_str());
+            return 1;
+        }
+        SaveArgs args = { snapshot, fp };
+        bool ok = R_ToplevelExec(save, &args);
+        ok = fclose(fp) == 0 && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+            fprintf(stderr, "CRcpp: cannot write snapshot %s\n", path.c_str());
+            remove(tmp.c_str());
+            return 1;
+        }
+    } catch (std::exception& ex) {
+        fprintf(stderr, "CRcpp: snapshot: %s\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
+
+// The snapshot file, mapped into memory (read into it under Windows).
+class SnapshotFile {
+public:
+    explicit SnapshotFile(const std::string& path) : data_m(0), size_m(0) {
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat sb;
+        if (fd < 0 || fstat(fd, &sb) != 0) {
+            if (fd >= 0)
+                close(fd);
+            return;
+        }
+        size_m = sb.st_size;
+        void* p = size_m == 0 ? MAP_FAILED :
+            mmap(0, size_m, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            size_m = 0;
+            return;
+        }
+        madvise(p, size_m, MADV_SEQUENTIAL);
+        data_m = static_cast<const char*>(p);
+#else
+        FILE* fp = fopen(path.c_str(), "rb");
+        if (fp == NULL)
+            return;
+        char chunk[65536];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+            buf_m.insert(buf_m.end(), chunk, chunk + n);
+        fclose(fp);
+        if (!buf_m.empty()) {
+            data_m = &buf_m[0];
+            size_m = buf_m.size();
+        }
+#endif
+    }
+    ~SnapshotFile() {
+#ifndef _WIN32
+        if (data_m != 0)
+            munmap(const_cast<char*>(data_m), size_m);
+#endif
+    }
+    const char* data() const { return data_m; }
+    size_t size() const { return size_m; }
+
+private:
+    SnapshotFile(const SnapshotFile&);
+    SnapshotFile& operator=(const SnapshotFile&);
+
+    const char* data_m;
+    size_t size_m;
+#ifdef _WIN32
+    std::vector<char> buf_m;
+#endif
+};
+
+struct LoadArgs {
+    const char* pos;
+    const char* end;
+    SEXP object;
+};
+
+static int inChar(R_inpstream_t stream) {
+    LoadArgs* args = static_cast<LoadArgs*>(stream->data);
+    if (args->pos >= args->end)
+        Rf_error("snapshot is truncated");
+    return (unsigned char)*args->pos++;
+}
+
+static void inBytes(R_inpstream_t stream, void* buf, int length) {
+    LoadArgs* args = static_cast<LoadArgs*>(stream->data);
+    if (length > args->end - args->pos)
+        Rf_error("snapshot is truncated");
+    memcpy(buf, args->pos, length);
+    args->pos += length;
+}
+
+// Run under R_ToplevelExec, like save().
+static void load(void* data) {
+    LoadArgs* args = static_cast<LoadArgs*>(data);
+    struct R_inpstream_st in;
+    R_InitInPStream(&in, args, R_pstream_any_format, inChar, inBytes,
+                    NULL, R_NilValue);
+    args->object = R_Unserialize(&in);
+    R_PreserveObject(args->object);
+}
+
+int snapshotRestore(RInside& R, const std::string& path) {
+    SEXP object;
+    {
+        SnapshotFile file(path);
+        if (file.data() == 0) {
+            fprintf(stderr, "CRcpp: cannot read snapshot %s\n", path.c_str());
+            return 1;
+        }
+        LoadArgs args = { file.data(), file.data() + file.size(), R_NilValue };
+        if (!R_ToplevelExec(load, &args)) {
+            fprintf(stderr, "CRcpp: cannot restore snapshot %s\n", path.c_str());
+            return 1;
+        }
+        object = args.object;
+    }
+    Rcpp::RObject held(object);
+    R_ReleaseObject(object);
+
+    try {
+        Rcpp::List snapshot(held);
+        if (!snapshot.containsElementNamed("format") ||
+            Rcpp::as<std::string>(snapshot["format"]) != SNAPSHOT_FORMAT) {
+            fprintf(stderr, "CRcpp: %s is not a CRcpp snapshot\n", path.c_str());
+            return 1;
+        }
+
+        Rcpp::Function loadNamespace("loadNamespace");
+        std::vector<std::string> namespaces =
+            Rcpp::as<std::vector<std::string> >(snapshot["namespaces"]);
+        for (size_t i = 0; i < namespaces.size(); i++)
+            loadNamespace(namespaces[i]);
+
+        // library() attaches in front of the others, so the deepest
+        // package goes first. Those attached already (the defaults) are
+        // left where they are.
+        Rcpp::Function library("library");
+        std::vector<std::string> attached =
+            Rcpp::as<std::vector<std::string> >(snapshot["attached"]);
+        std::vector<std::string> current = Rcpp::as<std::vector<std::string> >(
+            R.parseEval("sub('^package:', '', grep('^package:', search(), value = TRUE))"));
+        for (size_t i = attached.size(); i-- > 0; ) {
+            if (std::find(current.begin(), current.end(), attached[i]) == current.end())
+                library(attached[i], Rcpp::Named("character.only") = true);
+        }
+
+        Rcpp::List globals = snapshot["globals"];
+        if (globals.size() > 0) {
+            std::vector<std::string> names =
+                Rcpp::as<std::vector<std::string> >(globals.names());
+            for (R_xlen_t i = 0; i < globals.size(); i++)
+                Rf_defineVar(Rf_install(names[i].c_str()), globals[i], R_GlobalEnv);
+        }
+    } catch (std::exception& ex) {
+        fprintf(stderr, "CRcpp: restore: %s\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,27 @@
+// Startup snapshots for CRcpp: --snapshot saves the state of a session
+// after warmup (packages attached, scripts run), and --restore brings a
+// new session back to that state without running the warmup again.
+#ifndef CRCPP_SNAPSHOT_H
+#define CRCPP_SNAPSHOT_H
+
+#include <RInside.h>
+
+#include <string>
+
+// Writes the variables of the global environment, and the names of the
+// loaded namespaces and attached packages, to path in R's serialization
+// format (readable with readRDS). Autoloads and other promises that have
+// not been forced are left out, as are .Random.seed, argv and worker.id,
+// which belong to the process rather than to the warm state. Returns 0 on
+// success and 1 otherwise.
+int snapshotSave(RInside& R, const std::string& path);
+
+// Reads a snapshot written by snapshotSave, mapping the file into memory
+// rather than reading it through a connection: loads the namespaces,
+// attaches the packages in their original search order and assigns the
+// variables in the global environment. Namespaces are loaded again from
+// their installed packages; R has no way to restore them from bytes.
+// Returns 0 on success and 1 otherwise.
+int snapshotRestore(RInside& R, const std::string& path);
+
+#endif
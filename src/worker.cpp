@@ -0,0 +1,133 @@
+// Worker mode of CRcpp (see worker.h and supervisor/Protocol.h).
+#include "worker.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Protocol.h"
+
+using namespace crcpp;
+
+// Builds the response payload, with the result in a new shared memory
+// object whose descriptor is returned in *outfd (-1 if none).
+static std::string response(uint32_t status, uint32_t type, SEXP value,
+                            const std::string& message, int* outfd) {
+    *outfd = -1;
+    uint64_t length = value == R_NilValue ? 0 : XLENGTH(value);
+    if (length > 0) {
+        size_t bytes = length*elementSize(type);
+        int fd = shmCreate(bytes);
+        void* p = fd < 0 ? MAP_FAILED :
+            mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            if (fd >= 0)
+                close(fd);
+            return response(STATUS_BAD_RESULT, VEC_DOUBLE, R_NilValue,
+                            "cannot allocate shared memory for the result",
+                            outfd);
+        }
+        memcpy(p, type == VEC_COMPLEX ? (void*)COMPLEX(value) : (void*)REAL(value),
+               bytes);
+        munmap(p, bytes);
+        *outfd = fd;
+    }
+    std::string resp;
+    put32(resp, status);
+    put32(resp, type);
+    put64(resp, length);
+    put64(resp, message.size());
+    resp += message;
+    return resp;
+}
+
+static std::string handle(RInside& R, const std::string& req,
+                          const std::vector<int>& fds, int* outfd) {
+    Reader rd(req);
+    uint32_t magic = rd.get32();
+    uint32_t nvec = rd.get32();
+    std::string code = rd.getString(rd.get64());
+    if (!rd.ok() || magic != REQUEST_MAGIC || nvec != fds.size())
+        return response(STATUS_BAD_REQUEST, VEC_DOUBLE, R_NilValue,
+                        "malformed request", outfd);
+
+    try {
+        RInside::Statement st = R.prepare(code);
+        for (uint32_t i = 0; i < nvec; i++) {
+            uint32_t type = rd.get32();
+            uint32_t namelen = rd.get32();
+            uint64_t length = rd.get64();
+            std::string name = rd.getString(namelen);
+            if (!rd.ok() || (type != VEC_DOUBLE && type != VEC_COMPLEX))
+                return response(STATUS_BAD_REQUEST, VEC_DOUBLE, R_NilValue,
+                                "malformed request", outfd);
+            // The inputs are copied once, from the shared pages into
+            // the R vector.
+            size_t bytes = length*elementSize(type);
+            struct stat sb;
+            void* p = MAP_FAILED;
+            if (fstat(fds[i], &sb) == 0 && (uint64_t)sb.st_size >= bytes)
+                p = length == 0 ? 0 :
+                    mmap(0, bytes, PROT_READ, MAP_SHARED, fds[i], 0);
+            if (p == MAP_FAILED)
+                return response(STATUS_BAD_REQUEST, VEC_DOUBLE, R_NilValue,
+                                "cannot map input '" + name + "'", outfd);
+            Rcpp::RObject v(Rf_allocVector(type == VEC_COMPLEX ? CPLXSXP : REALSXP,
+                                           length));
+            if (length > 0) {
+                memcpy(type == VEC_COMPLEX ? (void*)COMPLEX(v) : (void*)REAL(v),
+                       p, bytes);
+                munmap(p, bytes);
+            }
+            st.bind(name, v);
+        }
+
+        SEXP ans = R_NilValue;
+        if (st.execute(ans) != 0) {
+            std::string msg = Rcpp::as<std::string>(R.parseEval("geterrmessage()"));
+            return response(STATUS_R_ERROR, VEC_DOUBLE, R_NilValue, msg, outfd);
+        }
+        Rcpp::RObject value(ans);
+        switch (TYPEOF(value)) {
+        case NILSXP:
+            return response(STATUS_OK, VEC_DOUBLE, R_NilValue, "", outfd);
+        case CPLXSXP:
+            return response(STATUS_OK, VEC_COMPLEX, value, "", outfd);
+        case LGLSXP:
+        case INTSXP:
+        case REALSXP:
+            value = Rf_coerceVector(value, REALSXP);
+            return response(STATUS_OK, VEC_DOUBLE, value, "", outfd);
+        default:
+            return response(STATUS_BAD_RESULT, VEC_DOUBLE, R_NilValue,
+                            std::string("result of type ") +
+                            Rf_type2char(TYPEOF(value)) +
+                            " is not numeric, complex or NULL", outfd);
+        }
+    } catch (std::exception& ex) {
+        return response(STATUS_R_ERROR, VEC_DOUBLE, R_NilValue, ex.what(), outfd);
+    }
+}
+
+int workerRun(RInside& R, int sock) {
+    std::string req;
+    std::vector<int> fds;
+    while (recvMessage(sock, req, fds, MAX_REQUEST)) {
+        int outfd;
+        std::string resp = handle(R, req, fds, &outfd);
+        for (size_t i = 0; i < fds.size(); i++)
+            close(fds[i]);
+        fds.clear();
+        bool sent = sendMessage(sock, resp, &outfd, outfd < 0 ? 0 : 1);
+        if (outfd >= 0)
+            close(outfd);
+        if (!sent)
+            break;
+    }
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,12 @@
+// Worker mode of CRcpp, run by the supervisor library
+// (supervisor/Supervisor.h) as CRcpp --worker FD.
+#ifndef CRCPP_WORKER_H
+#define CRCPP_WORKER_H
+
+#include <RInside.h>
+
+// Serves evaluation requests arriving on the socket sock until the
+// supervisor closes it; returns the exit status for CRcpp.
+int workerRun(RInside& R, int sock);
+
+#endif
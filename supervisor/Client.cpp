@@ -0,0 +1,65 @@
+// Client for CRcpp in server mode (see Client.h).
+#include "Client.h"
+
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace crcpp {
+
+Client::Client(const std::string& address) : sock_m(-1) {
+    std::string error;
+    sock_m = connectSocket(address, &error);
+    if (sock_m < 0)
+        throw std::runtime_error("cannot connect to CRcpp server: " + error);
+}
+
+Client::~Client() {
+    if (sock_m >= 0)
+        close(sock_m);
+}
+
+Reply Client::eval(const std::string& code, ResultFormat format) {
+    Reply reply;
+    reply.status = STATUS_WORKER_DIED;
+    reply.type = VEC_DOUBLE;
+    reply.length = 0;
+
+    std::string req, resp;
+    std::vector<int> fds;
+    put32(req, SERVER_MAGIC);
+    put32(req, format);
+    put64(req, code.size());
+    req += code;
+    if (sock_m < 0 || !sendMessage(sock_m, req) || !recvMessage(sock_m, resp, fds)) {
+        reply.message = "connection to CRcpp server lost";
+        if (sock_m >= 0)
+            close(sock_m);
+        sock_m = -1;
+        return reply;
+    }
+    for (size_t i = 0; i < fds.size(); i++)
+        close(fds[i]);
+
+    Reader rd(resp);
+    uint32_t status = rd.get32();
+    uint32_t type = rd.get32();
+    uint64_t length = rd.get64();
+    reply.message = rd.getString(rd.get64());
+    bool known = (type == VEC_DOUBLE || type == VEC_COMPLEX || type == VEC_SERIALIZED) &&
+        length <= resp.size();
+    if (known)
+        reply.data = rd.getString(length*elementSize(type));
+    if (!rd.ok() || !known) {
+        reply.status = STATUS_BAD_REQUEST;
+        reply.message = "malformed response from CRcpp server";
+        reply.data.clear();
+        return reply;
+    }
+    reply.status = (Status)status;
+    reply.type = (VectorType)type;
+    reply.length = length;
+    return reply;
+}
+
+} // namespace crcpp
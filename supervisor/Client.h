@@ -0,0 +1,64 @@
+// Client for CRcpp in server mode (CRcpp --listen ADDRESS).
+//
+// A CRcpp server keeps one warm embedded R and evaluates the code sent
+// by its clients in the global environment, through the parse cache of
+// RInside, so code sent repeatedly is parsed once. Requests from
+// different connections are served one at a time (by each process, when
+// the server was started with --prefork N). Any local program can use
+// R this way without starting R itself.
+//
+// Example:
+//   crcpp::Client c("unix:/tmp/crcpp.sock");
+//   crcpp::Reply r = c.eval("sum(1:10)");
+//   if (r.status == crcpp::STATUS_OK) use(r.real(), r.length);
+//   r = c.eval("lm(dist ~ speed, cars)", crcpp::FORMAT_SERIALIZED);
+//   ... r.data holds the model, serialized ...
+//
+// A Client is used by one thread at a time; open one per thread.
+#ifndef CRCPP_CLIENT_H
+#define CRCPP_CLIENT_H
+
+#include "Protocol.h"
+
+#include <complex>
+#include <string>
+
+namespace crcpp {
+
+struct Reply {
+    Status status;
+    std::string message;        // R's error message, if any
+    VectorType type;
+    uint64_t length;            // elements, or bytes if VEC_SERIALIZED
+    std::string data;           // the result, as sent
+
+    const double* real() const {
+        return reinterpret_cast<const double*>(data.data());
+    }
+    const std::complex<double>* complex() const {
+        return reinterpret_cast<const std::complex<double>*>(data.data());
+    }
+};
+
+class Client {
+public:
+    // Connects to address (unix:/path or tcp:host:port); throws
+    // std::runtime_error if that fails.
+    explicit Client(const std::string& address);
+    ~Client();
+
+    // Evaluates code on the server and returns the value of its last
+    // expression. status is STATUS_WORKER_DIED if the connection is
+    // lost, and the Client cannot be used after that.
+    Reply eval(const std::string& code, ResultFormat format = FORMAT_VECTOR);
+
+private:
+    Client(const Client&);
+    Client& operator=(const Client&);
+
+    int sock_m;
+};
+
+} // namespace crcpp
+
+#endif
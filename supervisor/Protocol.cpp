@@ -0,0 +1,352 @@
+// Wire protocol between the CRcpp supervisor and its workers (see
+// Protocol.h).
+#include "Protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0          // macOS: SIGPIPE is ignored by the supervisor
+#endif
+
+namespace crcpp {
+
+int shmCreate(size_t bytes) {
+    int fd = -1;
+#if defined(__linux__) && defined(SYS_memfd_create)
+    fd = (int)syscall(SYS_memfd_create, "crcpp-vector", 1U /* MFD_CLOEXEC */);
+#endif
+    if (fd < 0) {
+        // Unique name, unlinked at once: only the descriptor survives.
+        static unsigned counter = 0;
+        char name[64];
+        snprintf(name, sizeof(name), "/crcpp-%d-%u", (int)getpid(), counter++);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+            return -1;
+        shm_unlink(name);
+    }
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendMessage(int sock, const std::string& payload, const int* fds,
+                 int nfds) {
+    std::string msg;
+    put64(msg, payload.size());
+    msg += payload;
+
+    // The descriptors go with the first chunk sent.
+    std::vector<char> control(nfds > 0 ? CMSG_SPACE(nfds*sizeof(int)) : 0);
+    size_t sent = 0;
+    while (sent < msg.size()) {
+        struct iovec iov;
+        iov.iov_base = const_cast<char*>(msg.data()) + sent;
+        iov.iov_len = msg.size() - sent;
+        struct msghdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        if (sent == 0 && nfds > 0) {
+            mh.msg_control = &control[0];
+            mh.msg_controllen = control.size();
+            struct cmsghdr* cm = CMSG_FIRSTHDR(&mh);
+            cm->cmsg_level = SOL_SOCKET;
+            cm->cmsg_type = SCM_RIGHTS;
+            cm->cmsg_len = CMSG_LEN(nfds*sizeof(int));
+            memcpy(CMSG_DATA(cm), fds, nfds*sizeof(int));
+        }
+        ssize_t n = sendmsg(sock, &mh, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+bool sendMessage(int sock, const std::string& head, const void* body,
+                 size_t len) {
+    std::string prefix;
+    put64(prefix, head.size() + len);
+    struct iovec iov[3];
+    iov[0].iov_base = const_cast<char*>(prefix.data());
+    iov[0].iov_len = prefix.size();
+    iov[1].iov_base = const_cast<char*>(head.data());
+    iov[1].iov_len = head.size();
+    iov[2].iov_base = const_cast<void*>(body);
+    iov[2].iov_len = len;
+    struct iovec* next = iov;
+    int left = 3;
+    while (left > 0) {
+        struct msghdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_iov = next;
+        mh.msg_iovlen = left;
+        ssize_t n = sendmsg(sock, &mh, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return false;
+        // Skip what was sent, which may end inside an iovec.
+        size_t sent = n;
+        while (left > 0 && sent >= next->iov_len) {
+            sent -= next->iov_len;
+            next++;
+            left--;
+        }
+        if (left > 0) {
+            next->iov_base = static_cast<char*>(next->iov_base) + sent;
+            next->iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+// Fills in the socket address for address; returns its length, or 0.
+static socklen_t socketAddress(const std::string& address,
+                               struct sockaddr_storage* sa,
+                               std::string* error) {
+    memset(sa, 0, sizeof(*sa));
+    if (address.compare(0, 5, "unix:") == 0) {
+        std::string path = address.substr(5);
+        struct sockaddr_un* un = reinterpret_cast<struct sockaddr_un*>(sa);
+        if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+            if (error)
+                *error = "bad Unix socket path in " + address;
+            errno = EINVAL;
+            return 0;
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path.c_str(), path.size() + 1);
+        return sizeof(*un);
+    }
+    if (address.compare(0, 4, "tcp:") == 0) {
+        std::string rest = address.substr(4);
+        size_t colon = rest.rfind(':');
+        std::string host = rest.substr(0, colon);
+        int port = colon == std::string::npos ? -1 : atoi(rest.c_str() + colon + 1);
+        struct sockaddr_in* in = reinterpret_cast<struct sockaddr_in*>(sa);
+        struct sockaddr_in6* in6 = reinterpret_cast<struct sockaddr_in6*>(sa);
+        if (port > 0 && port < 65536) {
+            if (inet_pton(AF_INET, host.c_str(), &in->sin_addr) == 1) {
+                in->sin_family = AF_INET;
+                in->sin_port = htons((uint16_t)port);
+                return sizeof(*in);
+            }
+            // [::1]:port
+            if (host.size() > 2 && host[0] == '[' && host[host.size() - 1] == ']' &&
+                inet_pton(AF_INET6, host.substr(1, host.size() - 2).c_str(),
+                          &in6->sin6_addr) == 1) {
+                in6->sin6_family = AF_INET6;
+                in6->sin6_port = htons((uint16_t)port);
+                return sizeof(*in6);
+            }
+        }
+    }
+    if (error)
+        *error = "bad address " + address +
+            " (expected unix:/path or tcp:host:port, host numeric)";
+    errno = EINVAL;
+    return 0;
+}
+
+static int socketError(int fd, const std::string& what, std::string* error) {
+    int saved = errno;
+    if (error)
+        *error = what + ": " + strerror(saved);
+    if (fd >= 0)
+        close(fd);
+    errno = saved;
+    return -1;
+}
+
+// The server runs any code it is sent, without authentication, so it
+// only listens on loopback addresses: reaching it from another host
+// takes a tunnel the user sets up (ssh -L, say).
+static bool isLoopback(const struct sockaddr_storage& sa) {
+    if (sa.ss_family == AF_INET) {
+        const struct sockaddr_in* in = reinterpret_cast<const struct sockaddr_in*>(&sa);
+        return (ntohl(in->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (sa.ss_family == AF_INET6) {
+        const struct sockaddr_in6* in6 = reinterpret_cast<const struct sockaddr_in6*>(&sa);
+        return IN6_IS_ADDR_LOOPBACK(&in6->sin6_addr);
+    }
+    return true;
+}
+
+int listenSocket(const std::string& address, std::string* error) {
+    struct sockaddr_storage sa;
+    socklen_t len = socketAddress(address, &sa, error);
+    if (len == 0)
+        return -1;
+    if (!isLoopback(sa)) {
+        if (error)
+            *error = "refusing to listen on " + address +
+                ": not a loopback address (127.x.x.x or [::1])";
+        errno = EADDRNOTAVAIL;
+        return -1;
+    }
+    int fd = socket(sa.ss_family, SOCK_STREAM, 0);
+    if (fd < 0)
+        return socketError(fd, "socket", error);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (sa.ss_family == AF_UNIX) {
+        // A socket left by a server that is gone is replaced; one that
+        // still accepts connections is not.
+        const char* path = reinterpret_cast<struct sockaddr_un*>(&sa)->sun_path;
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe >= 0) {
+            if (connect(probe, reinterpret_cast<struct sockaddr*>(&sa), len) != 0 &&
+                errno == ECONNREFUSED)
+                unlink(path);
+            close(probe);
+        }
+    } else {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&sa), len) != 0)
+        return socketError(fd, "bind " + address, error);
+    if (listen(fd, 64) != 0)
+        return socketError(fd, "listen " + address, error);
+    return fd;
+}
+
+int connectSocket(const std::string& address, std::string* error) {
+    struct sockaddr_storage sa;
+    socklen_t len = socketAddress(address, &sa, error);
+    if (len == 0)
+        return -1;
+    int fd = socket(sa.ss_family, SOCK_STREAM, 0);
+    if (fd < 0)
+        return socketError(fd, "socket", error);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&sa), len) != 0)
+        return socketError(fd, "connect " + address, error);
+    if (sa.ss_family != AF_UNIX) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    return fd;
+}
+
+// Reads exactly len bytes, collecting descriptors that arrive with them.
+static bool recvAll(int sock, char* buf, size_t len, std::vector<int>& fds) {
+    char control[CMSG_SPACE(MAX_VECTORS*sizeof(int))];
+    size_t got = 0;
+    while (got < len) {
+        struct iovec iov;
+        iov.iov_base = buf + got;
+        iov.iov_len = len - got;
+        struct msghdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        mh.msg_control = control;
+        mh.msg_controllen = sizeof(control);
+        ssize_t n = recvmsg(sock, &mh, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&mh); cm != NULL;
+             cm = CMSG_NXTHDR(&mh, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+                int nfds = (int)((cm->cmsg_len - CMSG_LEN(0))/sizeof(int));
+                const int* p = reinterpret_cast<const int*>(CMSG_DATA(cm));
+                fds.insert(fds.end(), p, p + nfds);
+            }
+        }
+        got += n;
+    }
+    return true;
+}
+
+bool recvMessage(int sock, std::string& payload, std::vector<int>& fds,
+                 uint64_t maxLength) {
+    uint64_t len;
+    if (!recvAll(sock, reinterpret_cast<char*>(&len), sizeof(len), fds))
+        return false;
+    if (len > maxLength)
+        return false;
+    // The payload grows as it arrives, so a peer announcing a long one
+    // and sending little costs little memory.
+    const size_t chunk = 1 << 20;
+    payload.clear();
+    while (payload.size() < len) {
+        size_t got = payload.size();
+        size_t n = (size_t)std::min<uint64_t>(chunk, len - got);
+        payload.resize(got + n);
+        if (!recvAll(sock, &payload[got], n, fds))
+            return false;
+    }
+    return true;
+}
+
+void put32(std::string& buf, uint32_t x) {
+    buf.append(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+void put64(std::string& buf, uint64_t x) {
+    buf.append(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+uint32_t Reader::get32() {
+    uint32_t x = 0;
+    if (pos_m + sizeof(x) > buf_m.size()) {
+        ok_m = false;
+        return 0;
+    }
+    memcpy(&x, buf_m.data() + pos_m, sizeof(x));
+    pos_m += sizeof(x);
+    return x;
+}
+
+uint64_t Reader::get64() {
+    uint64_t x = 0;
+    if (pos_m + sizeof(x) > buf_m.size()) {
+        ok_m = false;
+        return 0;
+    }
+    memcpy(&x, buf_m.data() + pos_m, sizeof(x));
+    pos_m += sizeof(x);
+    return x;
+}
+
+std::string Reader::getString(uint64_t len) {
+    if (len > buf_m.size() - pos_m) {
+        ok_m = false;
+        return std::string();
+    }
+    std::string s = buf_m.substr(pos_m, len);
+    pos_m += len;
+    return s;
+}
+
+} // namespace crcpp
@@ -0,0 +1,107 @@
+// Wire protocol between the CRcpp supervisor and its worker processes.
+//
+// Messages travel over a Unix stream socket as a 64-bit length prefix
+// followed by the payload; numeric and complex vectors do not travel in
+// the payload but in shared memory (memfd, or an unlinked POSIX shm
+// object where memfd is unavailable) whose descriptors are attached to
+// the message with SCM_RIGHTS. Both ends run on the same host, so
+// integers are sent in native byte order.
+//
+// Request payload:  u32 magic, u32 nvec, u64 code length, code, then
+//                   per vector u32 type, u32 name length, u64 length,
+//                   name; one descriptor per vector, in order.
+// Response payload: u32 status, u32 type, u64 length, u64 message
+//                   length, message; one descriptor if length > 0.
+//
+// The server mode of CRcpp (CRcpp --listen, see Client.h) uses the same
+// framing over a Unix or TCP socket, without descriptors: results travel
+// in the payload, after the response header.
+//
+// Server request:   u32 SERVER_MAGIC, u32 format, u64 code length, code.
+// Server response:  the response header above, then length elements of
+//                   type (VEC_DOUBLE, VEC_COMPLEX), or length bytes of R
+//                   serialization (VEC_SERIALIZED).
+//
+// This code does not use the R API, so the supervisor library can be
+// linked into programs that do not embed R.
+#ifndef CRCPP_PROTOCOL_H
+#define CRCPP_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace crcpp {
+
+const uint32_t REQUEST_MAGIC = 0x4b575243;    // "CRWK"
+const uint32_t SERVER_MAGIC = 0x56535243;     // "CRSV"
+const int MAX_VECTORS = 64;                   // descriptors per message
+const uint64_t MAX_REQUEST = 64 << 20;        // bytes of request payload
+
+enum VectorType { VEC_DOUBLE = 1, VEC_COMPLEX = 2, VEC_SERIALIZED = 3 };
+
+// How the server returns results: numeric and complex vectors as their
+// elements (other results are STATUS_BAD_RESULT), or any R object in
+// R's serialization format (XDR, readable with unserialize()).
+enum ResultFormat { FORMAT_VECTOR = 0, FORMAT_SERIALIZED = 1 };
+
+enum Status {
+    STATUS_OK = 0,
+    STATUS_R_ERROR = 1,         // evaluation failed, message from R
+    STATUS_BAD_RESULT = 2,      // result not numeric, complex or NULL
+    STATUS_BAD_REQUEST = 3,
+    STATUS_WORKER_DIED = 4      // set by the supervisor or client, never sent
+};
+
+inline size_t elementSize(uint32_t type) {
+    return type == VEC_COMPLEX ? 2*sizeof(double) :
+        type == VEC_SERIALIZED ? 1 : sizeof(double);
+}
+
+// Returns a descriptor for bytes of zero-filled shared memory, or -1.
+int shmCreate(size_t bytes);
+
+// Sends one message with fds attached; false if the peer is gone.
+bool sendMessage(int sock, const std::string& payload,
+                 const int* fds = 0, int nfds = 0);
+
+// Sends head followed by len bytes at body as one message, without
+// copying body into the payload.
+bool sendMessage(int sock, const std::string& head, const void* body,
+                 size_t len);
+
+// Receives one message, appending any descriptors received to fds;
+// false on end of file or error, or if the peer announces a payload
+// longer than maxLength (servers and workers pass MAX_REQUEST).
+bool recvMessage(int sock, std::string& payload, std::vector<int>& fds,
+                 uint64_t maxLength = UINT64_MAX);
+
+// Sockets for the server, from an address "unix:/path/to/socket" or
+// "tcp:host:port" (a numeric host, as in tcp:127.0.0.1:7070). Both
+// return -1 with errno set on failure, and an error message in *error
+// if error is not null. listenSocket() replaces a stale Unix socket,
+// and refuses TCP addresses other than loopback ones (127.x.x.x, [::1]):
+// the server evaluates whatever it receives.
+int listenSocket(const std::string& address, std::string* error = 0);
+int connectSocket(const std::string& address, std::string* error = 0);
+
+// Appends to / reads from a payload, in native byte order.
+void put32(std::string& buf, uint32_t x);
+void put64(std::string& buf, uint64_t x);
+class Reader {
+public:
+    explicit Reader(const std::string& buf) : buf_m(buf), pos_m(0), ok_m(true) {}
+    uint32_t get32();
+    uint64_t get64();
+    std::string getString(uint64_t len);
+    bool ok() const { return ok_m; }
+private:
+    const std::string& buf_m;
+    size_t pos_m;
+    bool ok_m;
+};
+
+} // namespace crcpp
+
+#endif
@@ -0,0 +1,294 @@
+// Supervisor for a pool of CRcpp worker processes (see Supervisor.h).
+#include "Supervisor.h"
+
+#include <cerrno>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace crcpp {
+
+SharedVector::SharedVector()
+    : fd_m(-1), addr_m(0), type_m(VEC_DOUBLE), length_m(0) {
+}
+
+SharedVector::SharedVector(VectorType type, size_t length)
+    : fd_m(-1), addr_m(0), type_m(type), length_m(length) {
+    fd_m = shmCreate(bytes());
+    if (fd_m < 0)
+        throw std::bad_alloc();
+    if (length > 0) {
+        addr_m = mmap(0, bytes(), PROT_READ | PROT_WRITE, MAP_SHARED, fd_m, 0);
+        if (addr_m == MAP_FAILED) {
+            addr_m = 0;
+            release();
+            throw std::bad_alloc();
+        }
+    }
+}
+
+SharedVector SharedVector::adopt(int fd, VectorType type, size_t length) {
+    SharedVector v;
+    v.fd_m = fd;
+    v.type_m = type;
+    v.length_m = length;
+    if (length > 0) {
+        v.addr_m = mmap(0, v.bytes(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (v.addr_m == MAP_FAILED) {
+            v.addr_m = 0;
+            v.release();
+            throw std::bad_alloc();
+        }
+    }
+    return v;
+}
+
+SharedVector::SharedVector(SharedVector&& v)
+    : fd_m(v.fd_m), addr_m(v.addr_m), type_m(v.type_m), length_m(v.length_m) {
+    v.fd_m = -1;
+    v.addr_m = 0;
+    v.length_m = 0;
+}
+
+SharedVector& SharedVector::operator=(SharedVector&& v) {
+    if (this != &v) {
+        release();
+        fd_m = v.fd_m;
+        addr_m = v.addr_m;
+        type_m = v.type_m;
+        length_m = v.length_m;
+        v.fd_m = -1;
+        v.addr_m = 0;
+        v.length_m = 0;
+    }
+    return *this;
+}
+
+SharedVector::~SharedVector() {
+    release();
+}
+
+void SharedVector::release() {
+    if (addr_m != 0)
+        munmap(addr_m, bytes());
+    if (fd_m >= 0)
+        close(fd_m);
+    addr_m = 0;
+    fd_m = -1;
+    length_m = 0;
+}
+
+Supervisor::Supervisor(int nworkers, const std::string& executable,
+                       const std::vector<std::string>& args)
+    : executable_m(executable), args_m(args), workers_m(nworkers),
+      restarts_m(0) {
+#ifndef SO_NOSIGPIPE
+#ifndef __linux__
+    signal(SIGPIPE, SIG_IGN);   // no MSG_NOSIGNAL or SO_NOSIGPIPE
+#endif
+#endif
+    for (int i = 0; i < nworkers; i++) {
+        if (!spawn(workers_m[i])) {
+            for (int j = 0; j < i; j++)
+                reap(workers_m[j]);
+            throw std::runtime_error("cannot start worker " + executable);
+        }
+    }
+}
+
+Supervisor::~Supervisor() {
+    for (size_t i = 0; i < workers_m.size(); i++) {
+        Worker& w = workers_m[i];
+        if (w.pid <= 0)
+            continue;
+        close(w.sock);
+        int status;
+        while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR) {}
+    }
+}
+
+unsigned long Supervisor::restarts() const {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    return restarts_m;
+}
+
+// Starts a worker connected to w.sock; called with mutex_m held (or
+// from the constructor), so that no other worker inherits its socket.
+bool Supervisor::spawn(Worker& w) {
+    w.pid = -1;
+    w.sock = -1;
+    w.busy = false;
+    w.jobs = 0;
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+        return false;
+    fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(sv[0], SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    // Everything the child needs is built before fork(): only exec
+    // (and _exit) happen in the child.
+    std::string fdarg = std::to_string(sv[1]);
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(executable_m.c_str()));
+    for (size_t i = 0; i < args_m.size(); i++)
+        argv.push_back(const_cast<char*>(args_m[i].c_str()));
+    argv.push_back(const_cast<char*>("--worker"));
+    argv.push_back(const_cast<char*>(fdarg.c_str()));
+    argv.push_back(0);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+    if (pid == 0) {
+        execvp(argv[0], &argv[0]);
+        _exit(127);
+    }
+    close(sv[1]);
+    w.pid = pid;
+    w.sock = sv[0];
+    return true;
+}
+
+void Supervisor::reap(Worker& w) {
+    if (w.pid <= 0)
+        return;
+    close(w.sock);
+    kill(w.pid, SIGKILL);
+    int status;
+    while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR) {}
+    w.pid = -1;
+    w.sock = -1;
+}
+
+// Waits for an idle worker, picks the one that has run the fewest jobs,
+// and marks it busy; returns -1 if no worker is running. A worker found
+// to have exited while idle is restarted first.
+int Supervisor::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_m);
+    for (;;) {
+        int best = -1, alive = 0;
+        for (size_t i = 0; i < workers_m.size(); i++) {
+            Worker& w = workers_m[i];
+            if (w.pid <= 0)
+                continue;
+            alive++;
+            if (!w.busy && (best < 0 || w.jobs < workers_m[best].jobs))
+                best = (int)i;
+        }
+        if (alive == 0)
+            return -1;
+        if (best >= 0) {
+            Worker& w = workers_m[best];
+            int status;
+            if (waitpid(w.pid, &status, WNOHANG) == w.pid) {
+                w.pid = -1;
+                close(w.sock);
+                if (spawn(w))
+                    restarts_m++;
+                continue;
+            }
+            w.busy = true;
+            return best;
+        }
+        idle_m.wait(lock);
+    }
+}
+
+void Supervisor::release(int i, bool died) {
+    std::lock_guard<std::mutex> lock(mutex_m);
+    Worker& w = workers_m[i];
+    if (died) {
+        reap(w);
+        if (spawn(w))
+            restarts_m++;
+    } else {
+        w.busy = false;
+        w.jobs++;
+    }
+    idle_m.notify_one();
+}
+
+Result Supervisor::eval(const std::string& code, const Inputs& inputs) {
+    Result res;
+    res.status = STATUS_BAD_REQUEST;
+    res.worker = -1;
+    if (inputs.size() > (size_t)MAX_VECTORS) {
+        res.message = "too many input vectors";
+        return res;
+    }
+
+    std::string req;
+    std::vector<int> fds;
+    put32(req, REQUEST_MAGIC);
+    put32(req, (uint32_t)inputs.size());
+    put64(req, code.size());
+    req += code;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const SharedVector* v = inputs[i].second;
+        if (v == 0 || v->fd() < 0) {
+            res.message = "input '" + inputs[i].first + "' is not allocated";
+            return res;
+        }
+        put32(req, v->type());
+        put32(req, (uint32_t)inputs[i].first.size());
+        put64(req, v->length());
+        req += inputs[i].first;
+        fds.push_back(v->fd());
+    }
+
+    int i = acquire();
+    if (i < 0) {
+        res.status = STATUS_WORKER_DIED;
+        res.message = "no worker running";
+        return res;
+    }
+    res.worker = i;
+    int sock = workers_m[i].sock;
+    std::string resp;
+    std::vector<int> rfds;
+    bool ok = sendMessage(sock, req, fds.empty() ? 0 : &fds[0], (int)fds.size()) &&
+        recvMessage(sock, resp, rfds);
+    release(i, !ok);
+    if (!ok) {
+        for (size_t k = 0; k < rfds.size(); k++)
+            close(rfds[k]);
+        res.status = STATUS_WORKER_DIED;
+        res.message = "worker exited while evaluating the job";
+        return res;
+    }
+
+    Reader rd(resp);
+    uint32_t status = rd.get32();
+    uint32_t type = rd.get32();
+    uint64_t length = rd.get64();
+    res.message = rd.getString(rd.get64());
+    bool valid = rd.ok() && rfds.size() == (length > 0 ? 1u : 0u) &&
+        (type == VEC_DOUBLE || type == VEC_COMPLEX);
+    if (!valid) {
+        for (size_t k = 0; k < rfds.size(); k++)
+            close(rfds[k]);
+        res.status = STATUS_BAD_REQUEST;
+        res.message = "malformed response from worker";
+        return res;
+    }
+    res.status = (Status)status;
+    if (length > 0)
+        res.value = SharedVector::adopt(rfds[0], (VectorType)type, length);
+    return res;
+}
+
+} // namespace crcpp
@@ -0,0 +1,126 @@
+// Supervisor for a pool of CRcpp worker processes.
+//
+// RInside allows one interpreter per process, so using R on several
+// cores takes several processes. A Supervisor starts N copies of the
+// CRcpp executable in worker mode (CRcpp --worker FD), each connected
+// by a Unix socket pair, and evaluates R code on whichever worker is
+// free. Numeric and complex vectors are exchanged through shared memory
+// rather than serialized: inputs are allocated as SharedVectors and
+// filled in place, and results come back mapped from the memory the
+// worker wrote them to. A worker that dies is restarted; the job it was
+// running fails with STATUS_WORKER_DIED and is not retried, since it
+// may be what killed the worker.
+//
+// Example:
+//   crcpp::Supervisor pool(4, "./CRcpp", {"--packages", "Mypack"});
+//   crcpp::SharedVector z(crcpp::VEC_COMPLEX, n);
+//   ... fill z.complex() ...
+//   crcpp::Result r = pool.eval("cgamma(z)", {{"z", &z}});
+//   if (r.status == crcpp::STATUS_OK) use(r.value.complex(), r.value.length());
+//
+// eval() may be called from any number of threads; each call blocks
+// until a worker is free and has answered.
+#ifndef CRCPP_SUPERVISOR_H
+#define CRCPP_SUPERVISOR_H
+
+#include "Protocol.h"
+
+#include <complex>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+namespace crcpp {
+
+// A numeric or complex vector in shared memory, mapped read-write into
+// this process. Move-only; the mapping is released on destruction.
+class SharedVector {
+public:
+    SharedVector();
+    SharedVector(VectorType type, size_t length);   // throws std::bad_alloc
+    SharedVector(SharedVector&& v);
+    SharedVector& operator=(SharedVector&& v);
+    ~SharedVector();
+
+    // Maps length elements of type from fd, taking ownership of fd.
+    static SharedVector adopt(int fd, VectorType type, size_t length);
+
+    VectorType type() const { return type_m; }
+    size_t length() const { return length_m; }
+    size_t bytes() const { return length_m*elementSize(type_m); }
+    int fd() const { return fd_m; }
+
+    double* real() { return static_cast<double*>(addr_m); }
+    std::complex<double>* complex() { return static_cast<std::complex<double>*>(addr_m); }
+    const double* real() const { return static_cast<const double*>(addr_m); }
+    const std::complex<double>* complex() const { return static_cast<const std::complex<double>*>(addr_m); }
+
+private:
+    SharedVector(const SharedVector&);
+    SharedVector& operator=(const SharedVector&);
+    void release();
+
+    int fd_m;
+    void* addr_m;
+    VectorType type_m;
+    size_t length_m;
+};
+
+struct Result {
+    Status status;
+    std::string message;        // R's error message, if any
+    SharedVector value;         // numeric results as VEC_DOUBLE
+    int worker;                 // index of the worker that ran the job
+};
+
+class Supervisor {
+public:
+    typedef std::vector<std::pair<std::string, const SharedVector*> > Inputs;
+
+    // Starts nworkers workers running executable with args, followed by
+    // --worker FD. Throws std::runtime_error if a worker cannot start.
+    Supervisor(int nworkers, const std::string& executable = "CRcpp",
+               const std::vector<std::string>& args = std::vector<std::string>());
+
+    // Closes the sockets (workers exit on end of file) and waits for
+    // the workers. Must not run while eval() calls are in progress.
+    ~Supervisor();
+
+    // Evaluates code on a free worker with each input bound to its name,
+    // in an environment of its own enclosed by the worker's global
+    // environment, and returns the value of the last expression.
+    Result eval(const std::string& code, const Inputs& inputs = Inputs());
+
+    int workers() const { return (int)workers_m.size(); }
+    unsigned long restarts() const;
+
+private:
+    Supervisor(const Supervisor&);
+    Supervisor& operator=(const Supervisor&);
+
+    struct Worker {
+        pid_t pid;
+        int sock;
+        bool busy;
+        unsigned long jobs;
+    };
+
+    bool spawn(Worker& w);
+    void reap(Worker& w);
+    int acquire();
+    void release(int i, bool died);
+
+    std::string executable_m;
+    std::vector<std::string> args_m;
+    std::vector<Worker> workers_m;
+    mutable std::mutex mutex_m;
+    std::condition_variable idle_m;
+    unsigned long restarts_m;
+};
+
+} // namespace crcpp
+
+#endif